@@ -0,0 +1,1038 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#include "entitas/Collector.hpp"
+#include "entitas/CommandBuffer.hpp"
+#include "entitas/Context.hpp"
+#include "entitas/EntityIndex.hpp"
+#include "entitas/Matcher.hpp"
+#include "entitas/ReactiveSystem.hpp"
+#include "entitas/SharedCollector.hpp"
+#include "entitas/SortedGroup.hpp"
+#include "entitas/ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#if defined(__GLIBC__)
+#include <cxxabi.h>
+#include <execinfo.h>
+#endif
+
+#ifndef ENTITAS_BUILD_TYPE
+#define ENTITAS_BUILD_TYPE "unknown"
+#endif
+
+using namespace entitas;
+
+/* -------------------------------------------------------------------------- */
+
+/// Records the call sites of the allocations made on the thread between
+/// begin() and end(). Fixed size storage, recording must not allocate.
+class AllocationTracker {
+public:
+    static const int kMaxFrames = 24;
+    static const int kMaxSites = 64;
+
+    struct Site {
+        void* frames[kMaxFrames];
+        int depth;
+        unsigned long count;
+        std::size_t bytes;
+    };
+
+    static void begin()
+    {
+        sitesCount_ = 0;
+        allocations_ = 0;
+        tracking_ = true;
+    }
+
+    static void end()
+    {
+        tracking_ = false;
+    }
+
+    static void record(std::size_t size)
+    {
+        if (!tracking_) {
+            return;
+        }
+
+        // Whatever the stack walk allocates is not ours
+        tracking_ = false;
+        ++allocations_;
+
+        Site site{};
+#if defined(__GLIBC__)
+        site.depth = backtrace(site.frames, kMaxFrames);
+#endif
+        auto found = std::find_if(sites_, sites_ + sitesCount_, [&](const Site& s) {
+            return s.depth == site.depth && std::equal(s.frames, s.frames + s.depth, site.frames);
+        });
+        if (found != sites_ + sitesCount_) {
+            ++found->count;
+            found->bytes += size;
+        } else if (sitesCount_ < kMaxSites) {
+            site.count = 1;
+            site.bytes = size;
+            sites_[sitesCount_++] = site;
+        }
+
+        tracking_ = true;
+    }
+
+    static auto getAllocationsCount() -> unsigned long { return allocations_; }
+
+    /// Call sites of the last tracked run, outside of the tracker and of
+    /// operator new
+    static void printSites(std::FILE* file)
+    {
+        for (int i = 0; i < sitesCount_; ++i) {
+            const auto& site = sites_[i];
+            std::fprintf(file, "  %lu allocations, %zu bytes at\n", site.count, site.bytes);
+#if defined(__GLIBC__)
+            auto symbols = backtrace_symbols(site.frames, site.depth);
+            for (int f = 2; f < site.depth && symbols != nullptr; ++f) {
+                std::fprintf(file, "    %s\n", demangle(symbols[f]).c_str());
+            }
+            std::free(symbols);
+#else
+            std::fprintf(file, "    (no stack traces on this platform)\n");
+#endif
+        }
+    }
+
+private:
+#if defined(__GLIBC__)
+    /// "binary(symbol+offset) [address]", the symbol demangled
+    static auto demangle(const char* symbol) -> std::string
+    {
+        std::string text = symbol;
+        auto begin = text.find('(');
+        auto end = text.find('+', begin);
+        if (begin == std::string::npos || end == std::string::npos || end == begin + 1) {
+            return text;
+        }
+
+        int status = 0;
+        auto name = abi::__cxa_demangle(text.substr(begin + 1, end - begin - 1).c_str(), nullptr, nullptr, &status);
+        if (status == 0 && name != nullptr) {
+            text = text.substr(0, begin + 1) + name + text.substr(end);
+        }
+        std::free(name);
+        return text;
+    }
+#endif
+
+    static thread_local bool tracking_;
+    static thread_local unsigned long allocations_;
+    static thread_local Site sites_[kMaxSites];
+    static thread_local int sitesCount_;
+};
+
+thread_local bool AllocationTracker::tracking_ = false;
+thread_local unsigned long AllocationTracker::allocations_ = 0;
+thread_local AllocationTracker::Site AllocationTracker::sites_[kMaxSites];
+thread_local int AllocationTracker::sitesCount_ = 0;
+
+// Replaced for the whole program, the array and nothrow forms go through these.
+// gcc can't tell that they pair malloc() and free() on purpose.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size)
+{
+    AllocationTracker::record(size);
+    if (auto p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+/* -------------------------------------------------------------------------- */
+
+struct Position : public IComponent {
+    void reset(float px, float py)
+    {
+        x = px;
+        y = py;
+    }
+
+    float x{ 0.f };
+    float y{ 0.f };
+};
+
+struct Velocity : public IComponent {
+    void reset(float px, float py)
+    {
+        x = px;
+        y = py;
+    }
+
+    float x{ 0.f };
+    float y{ 0.f };
+};
+
+/// Counts the references taken on the entity and the group while an event is
+/// being delivered. Every extra reference is an atomic increment and
+/// decrement done by the event path itself.
+struct RefProbe {
+    void begin(const EntityPtr& entity, const Group::SharedPtr& group)
+    {
+        entityBaseline = entity.use_count();
+        groupBaseline = group.use_count();
+    }
+
+    void sample(const EntityPtr& entity, const Group::SharedPtr& group)
+    {
+        maxEntityRefs = std::max(maxEntityRefs, entity.use_count() - entityBaseline);
+        maxGroupRefs = std::max(maxGroupRefs, group.use_count() - groupBaseline);
+    }
+
+    long entityBaseline{ 0 };
+    long groupBaseline{ 0 };
+    long maxEntityRefs{ 0 };
+    long maxGroupRefs{ 0 };
+};
+
+static auto measureRefsInFlight() -> RefProbe
+{
+    Context context;
+    auto group = context.getGroup(Matcher_allOf(Position));
+    auto entity = context.createEntity();
+
+    RefProbe probe;
+    group->onEntityAdded += { 1, [&](const Group::SharedPtr& g, const EntityPtr& e, ComponentId, IComponent*) { probe.sample(e, g); } };
+    group->onEntityRemoved += { 1, [&](const Group::SharedPtr& g, const EntityPtr& e, ComponentId, IComponent*) { probe.sample(e, g); } };
+
+    probe.begin(entity, group);
+    entity->add<Position>(1.f, 2.f);
+    entity->remove<Position>();
+    return probe;
+}
+
+/// Components only used to make distinct groups
+template <std::size_t N>
+struct Tag : public IComponent {
+    void reset() {}
+};
+
+template <std::size_t... I>
+static auto getTagIds(std::index_sequence<I...>) -> ComponentIdList
+{
+    return { ComponentTypeId::get<Tag<I>>()... };
+}
+
+static const std::size_t kMaxGroups = 16;
+
+/// 'count' distinct groups all containing every entity with a Position
+static void createPositionGroups(Context& context, unsigned int count)
+{
+    auto tags = getTagIds(std::make_index_sequence<kMaxGroups>());
+    for (unsigned int i = 0; i < count; ++i) {
+        context.getGroup(Matcher::anyOf(ComponentIdList{ ComponentTypeId::get<Position>(), tags[i] }));
+    }
+}
+
+static auto getPositionMatcher() -> Matcher
+{
+    return Matcher::allOf(ComponentIdList{ ComponentTypeId::get<Position>() });
+}
+
+/* -------------------------------------------------------------------------- */
+
+struct Result {
+    std::string name;
+    unsigned int entities;
+    unsigned int groups;
+    unsigned long operations;
+    double nsPerOperation;
+};
+
+/// Collects the results and writes them as JSON
+class Report {
+public:
+    void add(const std::string& name, unsigned int entities, unsigned int groups, unsigned long operations, double elapsedNs)
+    {
+        auto result = Result{ name, entities, groups, operations, elapsedNs / std::max(operations, 1ul) };
+        std::printf("%-28s %8u entities %3u groups %12.1f ns/op\n", name.c_str(), entities, groups, result.nsPerOperation);
+        std::fflush(stdout);
+        results_.push_back(std::move(result));
+    }
+
+    bool write(const char* path) const
+    {
+        auto file = std::fopen(path, "w");
+        if (file == nullptr) {
+            return false;
+        }
+
+        std::fprintf(file, "{\n  \"build\": \"%s\",\n  \"results\": [\n", ENTITAS_BUILD_TYPE);
+        for (std::size_t i = 0; i < results_.size(); ++i) {
+            const auto& r = results_[i];
+            std::fprintf(file, "    { \"name\": \"%s\", \"entities\": %u, \"groups\": %u, \"operations\": %lu, \"ns_per_op\": %.3f }%s\n",
+                r.name.c_str(), r.entities, r.groups, r.operations, r.nsPerOperation, i + 1 < results_.size() ? "," : "");
+        }
+        std::fprintf(file, "  ]\n}\n");
+
+        return std::fclose(file) == 0;
+    }
+
+private:
+    std::vector<Result> results_;
+};
+
+using Clock = std::chrono::steady_clock;
+
+static auto getElapsedNs(Clock::time_point start) -> double
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+/// Small sizes repeat the measure to get enough operations
+static auto getRounds(unsigned int entitiesCount) -> unsigned int
+{
+    return std::max(1u, 1000000u / entitiesCount);
+}
+
+static void benchCreateDestroy(Report& report, unsigned int entitiesCount)
+{
+    Context context;
+    Entities entities;
+    entities.reserve(entitiesCount);
+
+    double createNs = 0.0;
+    double destroyNs = 0.0;
+    auto rounds = getRounds(entitiesCount);
+    for (unsigned int r = 0; r < rounds; ++r) {
+        auto start = Clock::now();
+        for (unsigned int i = 0; i < entitiesCount; ++i) {
+            entities.push_back(context.createEntity());
+        }
+        createNs += getElapsedNs(start);
+
+        start = Clock::now();
+        for (auto& entity : entities) {
+            context.destroyEntity(entity);
+        }
+        destroyNs += getElapsedNs(start);
+        entities.clear();
+    }
+
+    report.add("createEntity", entitiesCount, 0, 1ul * rounds * entitiesCount, createNs);
+    report.add("destroyEntity", entitiesCount, 0, 1ul * rounds * entitiesCount, destroyNs);
+}
+
+static void benchComponents(Report& report, unsigned int entitiesCount, unsigned int groupsCount)
+{
+    Context context;
+    createPositionGroups(context, groupsCount);
+
+    Entities entities;
+    for (unsigned int i = 0; i < entitiesCount; ++i) {
+        entities.push_back(context.createEntity());
+    }
+
+    double addNs = 0.0;
+    double replaceNs = 0.0;
+    double removeNs = 0.0;
+    auto rounds = getRounds(entitiesCount);
+    for (unsigned int r = 0; r < rounds; ++r) {
+        auto start = Clock::now();
+        for (auto& e : entities) {
+            e->add<Position>(1.f, 2.f);
+        }
+        addNs += getElapsedNs(start);
+
+        start = Clock::now();
+        for (auto& e : entities) {
+            e->replace<Position>(3.f, 4.f);
+        }
+        replaceNs += getElapsedNs(start);
+
+        start = Clock::now();
+        for (auto& e : entities) {
+            e->remove<Position>();
+        }
+        removeNs += getElapsedNs(start);
+    }
+
+    auto operations = 1ul * rounds * entitiesCount;
+    report.add("add", entitiesCount, groupsCount, operations, addNs);
+    report.add("replace", entitiesCount, groupsCount, operations, replaceNs);
+    report.add("remove", entitiesCount, groupsCount, operations, removeNs);
+}
+
+static void benchIteration(Report& report, unsigned int entitiesCount)
+{
+    Context context;
+    auto group = context.getGroup(getPositionMatcher());
+    for (unsigned int i = 0; i < entitiesCount; ++i) {
+        context.createEntity()->add<Position>(1.f, 2.f);
+    }
+
+    // Builds the entities cache of the group
+    group->getEntities();
+
+    float sum = 0.f;
+    auto rounds = getRounds(entitiesCount);
+    auto start = Clock::now();
+    for (unsigned int r = 0; r < rounds; ++r) {
+        for (auto& e : group->getEntities()) {
+            sum += e->get<Position>()->x;
+        }
+    }
+
+    report.add("group iteration get<T>", entitiesCount, 1, 1ul * rounds * entitiesCount, getElapsedNs(start));
+    if (sum < 0.f) {
+        std::printf("%f\n", sum);
+    }
+}
+
+static void benchGetGroup(Report& report, unsigned int entitiesCount)
+{
+    Context context;
+    for (unsigned int i = 0; i < entitiesCount; ++i) {
+        context.createEntity()->add<Position>(1.f, 2.f);
+    }
+
+    // A new group goes through all the entities
+    auto tags = getTagIds(std::make_index_sequence<kMaxGroups>());
+    auto start = Clock::now();
+    for (auto tag : tags) {
+        context.getGroup(Matcher::anyOf(ComponentIdList{ ComponentTypeId::get<Position>(), tag }));
+    }
+    report.add("getGroup new", entitiesCount, 0, tags.size(), getElapsedNs(start));
+
+    const unsigned int lookups = 100000;
+    auto matcher = getPositionMatcher();
+    context.getGroup(matcher);
+    start = Clock::now();
+    for (unsigned int i = 0; i < lookups; ++i) {
+        context.getGroup(matcher);
+    }
+    report.add("getGroup cached", entitiesCount, 0, lookups, getElapsedNs(start));
+}
+
+struct PositionReactiveSystem : public IReactiveSystem {
+    PositionReactiveSystem()
+    {
+        trigger = getPositionMatcher().onEntityAdded();
+    }
+
+    void execute(Entities& entities) override
+    {
+        for (auto& e : entities) {
+            sum += e->get<Position>()->x;
+        }
+    }
+
+    float sum{ 0.f };
+};
+
+static void benchReactive(Report& report, unsigned int entitiesCount)
+{
+    Context context;
+    auto collector = context.getGroup(getPositionMatcher())->createCollector(GroupEventType::Added);
+    auto system = std::static_pointer_cast<ReactiveSystem>(context.createSystem<PositionReactiveSystem>());
+
+    Entities entities;
+    for (unsigned int i = 0; i < entitiesCount; ++i) {
+        entities.push_back(context.createEntity());
+    }
+
+    // Adding with an active collector and reactive system, then reading
+    // what they collected
+    double collectNs = 0.0;
+    double collectorNs = 0.0;
+    double systemNs = 0.0;
+    auto rounds = getRounds(entitiesCount);
+    for (unsigned int r = 0; r < rounds; ++r) {
+        auto start = Clock::now();
+        for (auto& e : entities) {
+            e->add<Position>(1.f, 2.f);
+        }
+        collectNs += getElapsedNs(start);
+
+        start = Clock::now();
+        float sum = 0.f;
+        for (auto& e : collector->getCollectedEntities()) {
+            sum += e->get<Position>()->x;
+        }
+        collector->clearCollectedEntities();
+        collectorNs += getElapsedNs(start);
+
+        start = Clock::now();
+        system->execute();
+        systemNs += getElapsedNs(start);
+
+        for (auto& e : entities) {
+            e->remove<Position>();
+        }
+    }
+
+    auto operations = 1ul * rounds * entitiesCount;
+    report.add("add collected", entitiesCount, 1, operations, collectNs);
+    report.add("Collector read and clear", entitiesCount, 1, operations, collectorNs);
+    report.add("ReactiveSystem execute", entitiesCount, 1, operations, systemNs);
+}
+
+static void benchDelegate(Report& report, unsigned int handlersCount)
+{
+    Delegate<void(int)> delegate;
+    int sum = 0;
+    for (unsigned int i = 0; i < handlersCount; ++i) {
+        delegate.connect([&sum](int value) { sum += value; });
+    }
+
+    const unsigned int invocations = 1000000;
+    auto start = Clock::now();
+    for (unsigned int i = 0; i < invocations; ++i) {
+        delegate(1);
+    }
+
+    report.add(handlersCount == 1 ? "Delegate invoke 1 handler" : "Delegate invoke " + std::to_string(handlersCount) + " handlers",
+        0, 0, invocations, getElapsedNs(start));
+    if (sum < 0) {
+        std::printf("%d\n", sum);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+// Once warmed up, a frame of the engine should not allocate. Every scenario
+// runs its frame a few times, then once more while the allocations are
+// tracked.
+
+static const unsigned int kAllocationEntities = 10000;
+static const unsigned int kWarmupFrames = 3;
+
+/// Returns false and prints the call sites if the tracked frame allocated
+static bool checkAllocations(const char* name, const std::function<void()>& frame)
+{
+    for (unsigned int i = 0; i < kWarmupFrames; ++i) {
+        frame();
+    }
+
+    AllocationTracker::begin();
+    frame();
+    AllocationTracker::end();
+
+    auto allocations = AllocationTracker::getAllocationsCount();
+    std::printf("%-28s %8lu allocations\n", name, allocations);
+    if (allocations > 0) {
+        AllocationTracker::printSites(stdout);
+    }
+    std::fflush(stdout);
+
+    return allocations == 0;
+}
+
+static bool checkAllocations()
+{
+    // Loads what the stack walk needs before anything gets tracked
+    AllocationTracker::begin();
+    delete new int(0);
+    AllocationTracker::end();
+
+    auto ok = true;
+
+    {
+        Context context;
+        createPositionGroups(context, 4);
+        Entities entities;
+        for (unsigned int i = 0; i < kAllocationEntities; ++i) {
+            entities.push_back(context.createEntity());
+            entities.back()->add<Position>(1.f, 2.f);
+        }
+
+        ok &= checkAllocations("replace", [&] {
+            for (auto& e : entities) {
+                e->replace<Position>(3.f, 4.f);
+            }
+        });
+
+        ok &= checkAllocations("remove and add", [&] {
+            for (auto& e : entities) {
+                e->remove<Position>();
+            }
+            for (auto& e : entities) {
+                e->add<Position>(1.f, 2.f);
+            }
+        });
+
+        auto group = context.getGroup(getPositionMatcher());
+        float sum = 0.f;
+        ok &= checkAllocations("group iteration", [&] {
+            for (auto& e : group->getEntities()) {
+                sum += e->get<Position>()->x;
+            }
+        });
+        if (sum < 0.f) {
+            std::printf("%f\n", sum);
+        }
+    }
+
+    {
+        Context context;
+        createPositionGroups(context, 4);
+        Entities entities;
+        entities.reserve(kAllocationEntities);
+        ok &= checkAllocations("create and destroy", [&] {
+            for (unsigned int i = 0; i < kAllocationEntities; ++i) {
+                entities.push_back(context.createEntity());
+                entities.back()->add<Position>(1.f, 2.f)->add<Velocity>(0.f, 1.f);
+            }
+            for (auto& e : entities) {
+                context.destroyEntity(e);
+            }
+            entities.clear();
+        });
+    }
+
+    {
+        Context context;
+        auto group = context.getGroup(getPositionMatcher());
+        auto collector = group->createCollector(GroupEventType::Added);
+        auto system = std::static_pointer_cast<ReactiveSystem>(context.createSystem<PositionReactiveSystem>());
+        unsigned long batched = 0;
+        group->onEntitiesAdded += { 1, [&](const Group::SharedPtr&, const Group::EntityChanges& changes) { batched += changes.size(); } };
+
+        Entities entities;
+        for (unsigned int i = 0; i < kAllocationEntities; ++i) {
+            entities.push_back(context.createEntity());
+        }
+
+        ok &= checkAllocations("collected, reacted, flushed", [&] {
+            for (auto& e : entities) {
+                e->add<Position>(1.f, 2.f);
+            }
+            collector->clearCollectedEntities();
+            system->execute();
+            context.flush();
+            for (auto& e : entities) {
+                e->remove<Position>();
+            }
+        });
+    }
+
+    {
+        Delegate<void(int)> delegate;
+        int sum = 0;
+        for (unsigned int i = 0; i < 8; ++i) {
+            delegate.connect([&sum](int value) { sum += value; });
+        }
+
+        ok &= checkAllocations("Delegate invoke", [&] {
+            for (unsigned int i = 0; i < kAllocationEntities; ++i) {
+                delegate(1);
+            }
+        });
+    }
+
+    return ok;
+}
+
+/* -------------------------------------------------------------------------- */
+
+// The optimized paths have to give the same results as the plain ones.
+// Every scenario makes random changes over a few frames and compares what
+// a feature reports with what the context says is true.
+
+static const unsigned int kBehaviorEntities = 2000;
+static const unsigned int kBehaviorFrames = 8;
+
+/// Prints the outcome of a scenario and returns it
+static bool checkBehavior(const char* name, bool passed)
+{
+    std::printf("%-28s %s\n", name, passed ? "ok" : "FAILED");
+    std::fflush(stdout);
+    return passed;
+}
+
+/// Random changes to the Position of 'entities', some in place. Entities
+/// without a Position get one, the x values stay unique.
+static void changePositions(Context& context, Entities& entities, std::mt19937& random, float& nextX)
+{
+    for (auto& e : entities) {
+        switch (random() % 8) {
+        case 0:
+            if (e->has<Position>()) {
+                e->remove<Position>();
+            } else {
+                e->add<Position>(nextX++, static_cast<float>(random() % 10));
+            }
+            break;
+        case 1:
+            e->replace<Position>(nextX++, static_cast<float>(random() % 10));
+            break;
+        case 2:
+            if (e->has<Position>()) {
+                e->modify<Position>().y = static_cast<float>(random() % 10);
+            }
+            break;
+        case 3:
+            if (e->has<Position>()) {
+                e->get<Position>()->x = nextX++;
+                e->refresh<Position>();
+            }
+            break;
+        case 4:
+            if (random() % 8 == 0) {
+                context.destroyEntity(e);
+                e = context.createEntity();
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static auto createPositionEntities(Context& context, float& nextX) -> Entities
+{
+    Entities entities;
+    for (unsigned int i = 0; i < kBehaviorEntities; ++i) {
+        entities.push_back(context.createEntity());
+        entities.back()->add<Position>(nextX++, static_cast<float>(i % 10));
+    }
+    return entities;
+}
+
+static bool checkEntityIndices()
+{
+    Context context;
+    auto group = context.getGroup(getPositionMatcher());
+    PrimaryEntityIndex<Position, int> byX(group, [](const Position& p) { return static_cast<int>(p.x); });
+    EntityIndex<Position, int> byY(group, [](const Position& p) { return static_cast<int>(p.y); });
+
+    std::mt19937 random(26);
+    auto nextX = 0.f;
+    auto entities = createPositionEntities(context, nextX);
+
+    auto ok = true;
+    for (unsigned int frame = 0; frame < kBehaviorFrames; ++frame) {
+        changePositions(context, entities, random, nextX);
+        context.flush();
+
+        std::size_t indexedByY = 0;
+        for (int y = 0; y < 10; ++y) {
+            indexedByY += byY.getEntities(y).size();
+        }
+        ok &= byX.count() == group->count() && indexedByY == group->count();
+
+        for (auto& e : group->getEntities()) {
+            auto position = e->get<Position>();
+            ok &= byX.getEntity(static_cast<int>(position->x)) == e;
+            ok &= byY.getEntities(static_cast<int>(position->y)).count(e) == 1;
+        }
+    }
+
+    return checkBehavior("entity indices", ok);
+}
+
+static bool checkSortedGroups()
+{
+    Context context;
+    auto group = context.getGroup(getPositionMatcher());
+    SortedGroup<Position> sorted(group, [](const Position& left, const Position& right) { return left.x > right.x; });
+
+    std::mt19937 random(28);
+    auto nextX = 0.f;
+    auto entities = createPositionEntities(context, nextX);
+
+    auto ok = true;
+    for (unsigned int frame = 0; frame < kBehaviorFrames; ++frame) {
+        // Few changes are inserted one by one, many are merged
+        if (frame % 2 == 0) {
+            for (unsigned int i = 0; i < SortedGroup<Position>::kInsertionThreshold / 2; ++i) {
+                entities[random() % entities.size()]->replace<Position>(nextX++, 0.f);
+            }
+        } else {
+            changePositions(context, entities, random, nextX);
+            context.flush();
+        }
+
+        const auto& ordered = sorted.getEntities();
+        ok &= ordered.size() == group->count() && sorted.count() == group->count();
+        for (std::size_t i = 0; i < ordered.size(); ++i) {
+            ok &= group->containsEntity(ordered[i]);
+            ok &= i == 0 || ordered[i - 1]->get<Position>()->x >= ordered[i]->get<Position>()->x;
+        }
+    }
+
+    return checkBehavior("sorted groups", ok);
+}
+
+/// Events hand out the references the entity and the group hold on
+/// themselves, without taking new ones
+static bool checkRefsInFlight()
+{
+    auto probe = measureRefsInFlight();
+    return checkBehavior("refs in flight", probe.maxEntityRefs == 0 && probe.maxGroupRefs == 0);
+}
+
+static bool checkBatchedEvents()
+{
+    Context context;
+    auto group = context.getGroup(getPositionMatcher());
+
+    // Immediate and batched counts of created, destroyed, added, removed
+    // and updated, the batched ones only move on flush
+    unsigned long immediate[5] = {};
+    unsigned long batched[5] = {};
+    context.onEntityCreated += { 1, [&](Context*, const EntityPtr&) { ++immediate[0]; } };
+    context.onEntityDestroyed += { 1, [&](Context*, const EntityPtr&) { ++immediate[1]; } };
+    group->onEntityAdded += { 1, [&](const Group::SharedPtr&, const EntityPtr&, ComponentId, IComponent*) { ++immediate[2]; } };
+    group->onEntityRemoved += { 1, [&](const Group::SharedPtr&, const EntityPtr&, ComponentId, IComponent*) { ++immediate[3]; } };
+    group->onEntityUpdated += { 1, [&](const Group::SharedPtr&, const EntityPtr&, ComponentId, IComponent*, IComponent*) { ++immediate[4]; } };
+    context.onEntitiesCreated += { 1, [&](Context*, const Entities& entities) { batched[0] += entities.size(); } };
+    context.onEntitiesDestroyed += { 1, [&](Context*, const Entities& entities) { batched[1] += entities.size(); } };
+    group->onEntitiesAdded += { 1, [&](const Group::SharedPtr&, const Group::EntityChanges& changes) { batched[2] += changes.size(); } };
+    group->onEntitiesRemoved += { 1, [&](const Group::SharedPtr&, const Group::EntityChanges& changes) { batched[3] += changes.size(); } };
+    group->onEntitiesUpdated += { 1, [&](const Group::SharedPtr&, const Group::EntityChanges& changes) { batched[4] += changes.size(); } };
+
+    std::mt19937 random(35);
+    auto nextX = 0.f;
+    auto entities = createPositionEntities(context, nextX);
+
+    auto ok = true;
+    for (unsigned int frame = 0; frame < kBehaviorFrames; ++frame) {
+        unsigned long before[5];
+        std::copy(std::begin(batched), std::end(batched), before);
+        changePositions(context, entities, random, nextX);
+        ok &= std::equal(std::begin(batched), std::end(batched), before);
+
+        // In place changes are only reported, to both, by the flush
+        context.flush();
+        ok &= std::equal(std::begin(batched), std::end(batched), immediate);
+    }
+
+    return checkBehavior("batched events", ok);
+}
+
+static bool checkSharedCollectors()
+{
+    Context context;
+    auto triggers = std::vector<TriggerOnEvent>{ getPositionMatcher().onEntityAdded() };
+    auto shared = context.getSharedCollector(triggers);
+    auto reference = context.getGroup(getPositionMatcher())->createCollector(GroupEventType::Added);
+    auto ok = context.getSharedCollector(triggers) == shared;
+    auto added = getPositionMatcher().onEntityAdded();
+    auto removed = getPositionMatcher().onEntityRemoved();
+    ok &= context.getSharedCollector({ added, added, removed }) != context.getSharedCollector({ added, removed, removed });
+
+    // 'every' reads each frame, 'sometimes' every other frame
+    auto every = shared->addConsumer();
+    auto sometimes = shared->addConsumer();
+
+    std::mt19937 random(38);
+    auto nextX = 0.f;
+    auto entities = createPositionEntities(context, nextX);
+    shared->clearCollectedEntities(every);
+    shared->clearCollectedEntities(sometimes);
+    reference->clearCollectedEntities();
+
+    std::unordered_set<EntityPtr> expected;
+    for (unsigned int frame = 0; frame < kBehaviorFrames; ++frame) {
+        changePositions(context, entities, random, nextX);
+        const auto& collected = reference->getCollectedEntities();
+        expected.insert(collected.begin(), collected.end());
+
+        // Entities collected several times are read once
+        auto sameAs = [](const Entities& read, const Collector::CollectedEntities& wanted) {
+            std::unordered_set<EntityPtr> unique(read.begin(), read.end());
+            return unique.size() == read.size() && unique.size() == wanted.size()
+                && std::all_of(read.begin(), read.end(), [&wanted](const EntityPtr& e) { return wanted.count(e) == 1; });
+        };
+
+        Entities read;
+        shared->readCollectedEntities(every, read);
+        ok &= sameAs(read, collected);
+
+        if (frame % 2 == 1) {
+            read.clear();
+            shared->readCollectedEntities(sometimes, read);
+            ok &= sameAs(read, Collector::CollectedEntities(expected.begin(), expected.end()));
+            expected.clear();
+        }
+        reference->clearCollectedEntities();
+    }
+
+    // A consumer that never reads keeps the log within a multiple of the
+    // entities it has not read, however often they are collected again
+    auto lagging = shared->addConsumer();
+    shared->clearCollectedEntities(sometimes);
+    for (unsigned int round = 0; round < 4 * kBehaviorFrames; ++round) {
+        for (auto& e : entities) {
+            e->replace<Position>(nextX++, 0.f);
+        }
+        ok &= shared->getLogSize() <= 2 * entities.size() + 64;
+
+        Entities read;
+        shared->readCollectedEntities(every, read);
+        ok &= read.size() == entities.size();
+    }
+
+    for (auto consumer : { lagging, sometimes }) {
+        Entities read;
+        shared->readCollectedEntities(consumer, read);
+        ok &= read.size() == entities.size()
+            && std::unordered_set<EntityPtr>(read.begin(), read.end()).size() == entities.size();
+    }
+    shared->removeConsumer(lagging);
+
+    return checkBehavior("shared collectors", ok);
+}
+
+/// Doubles the x of the collected entities and tags the odd ones through
+/// the command buffer of its chunk
+struct DoublingSystem : public IParallelReactiveSystem {
+    DoublingSystem()
+    {
+        trigger = getPositionMatcher().onEntityAdded();
+        chunkSize = 64;
+    }
+
+    void executeChunk(const EntityPtr* entities, std::size_t count, CommandBuffer& commands) override
+    {
+        for (std::size_t i = 0; i < count; ++i) {
+            auto position = entities[i]->get<Position>();
+            position->x *= 2.f;
+            if (static_cast<int>(position->y) % 2 == 1) {
+                commands.add<Velocity>(entities[i], 0.f, 1.f);
+            }
+        }
+    }
+};
+
+static bool checkThreadPool()
+{
+    ThreadPool pool(3);
+
+    // Every task runs once, nested calls included
+    std::vector<std::atomic<unsigned int>> runs(kBehaviorEntities);
+    pool.parallelFor(runs.size(), [&](std::size_t task) { ++runs[task]; });
+    pool.parallelFor(runs.size() / 100, [&](std::size_t outer) {
+        pool.parallelFor(100, [&](std::size_t inner) { ++runs[outer * 100 + inner]; });
+    });
+    auto ok = std::all_of(runs.begin(), runs.end(), [](const std::atomic<unsigned int>& r) { return r == 2; });
+
+    auto rethrown = false;
+    try {
+        pool.parallelFor(100, [](std::size_t task) {
+            if (task == 42) {
+                throw std::runtime_error("task 42");
+            }
+        });
+    } catch (const std::runtime_error&) {
+        rethrown = true;
+    }
+    ok &= rethrown;
+
+    Context context;
+    auto doubling = std::make_shared<DoublingSystem>();
+    doubling->threadPool = &pool;
+    auto system = std::static_pointer_cast<ReactiveSystem>(context.createSystem(doubling));
+    auto moving = context.getGroup(Matcher::allOf(ComponentIdList{ ComponentTypeId::get<Velocity>() }));
+
+    auto nextX = 1.f;
+    auto entities = createPositionEntities(context, nextX);
+    system->execute();
+    for (unsigned int i = 0; i < entities.size(); ++i) {
+        ok &= entities[i]->get<Position>()->x == 2.f * (i + 1);
+    }
+    ok &= moving->count() == kBehaviorEntities / 2;
+
+    return checkBehavior("thread pool", ok);
+}
+
+static bool checkBehavior()
+{
+    auto ok = true;
+    ok &= checkEntityIndices();
+    ok &= checkSortedGroups();
+    ok &= checkRefsInFlight();
+    ok &= checkBatchedEvents();
+    ok &= checkSharedCollectors();
+    ok &= checkThreadPool();
+    return ok;
+}
+
+int main(const int argc, const char* argv[])
+{
+    const char* jsonPath = "benchmark.json";
+    unsigned int maxEntities = 1000000;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--max-entities") == 0 && i + 1 < argc) {
+            maxEntities = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--check-allocations") == 0) {
+            return checkAllocations() ? 0 : 1;
+        } else if (std::strcmp(argv[i], "--check-behavior") == 0) {
+            return checkBehavior() ? 0 : 1;
+        } else {
+            std::fprintf(stderr, "usage: %s [--json path] [--max-entities count] [--check-allocations] [--check-behavior]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    auto probe = measureRefsInFlight();
+    std::printf("refs in flight per add/remove: entity %ld, group %ld\n", probe.maxEntityRefs, probe.maxGroupRefs);
+
+    Report report;
+    for (auto entitiesCount : { 1000u, 100000u, 1000000u }) {
+        if (entitiesCount > maxEntities) {
+            break;
+        }
+
+        benchCreateDestroy(report, entitiesCount);
+        for (auto groupsCount : { 1u, 4u, 16u }) {
+            benchComponents(report, entitiesCount, groupsCount);
+        }
+        benchIteration(report, entitiesCount);
+        benchGetGroup(report, entitiesCount);
+        benchReactive(report, entitiesCount);
+    }
+
+    for (auto handlersCount : { 1u, 8u }) {
+        benchDelegate(report, handlersCount);
+    }
+
+    if (!report.write(jsonPath)) {
+        std::fprintf(stderr, "cannot write %s\n", jsonPath);
+        return 1;
+    }
+
+    return 0;
+}
@@ -22,6 +22,7 @@ Collector::Collector(std::vector<Group::WeakPtr>&& groups, std::vector<GroupEven
     , eventTypes_{ eventTypes }
 {
     addEntityCache_ = std::bind(&Collector::addEntity, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4); // sizeof find out
+    updateEntityCache_ = std::bind(&Collector::updateEntity, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5);
 
     if (groups.size() != eventTypes.size()) {
         throw std::runtime_error("Error, group and eventType vector counts must be equal");
@@ -53,6 +54,11 @@ void Collector::activate()
             g->onEntityRemoved -= { index(), addEntityCache_ };
             g->onEntityRemoved += { index(), addEntityCache_ };
         }
+
+        // A replace used to be reported as removed and added again,
+        // so every event type keeps collecting replaced entities
+        g->onEntityUpdated -= { index(), updateEntityCache_ };
+        g->onEntityUpdated += { index(), updateEntityCache_ };
     }
 }
 
@@ -63,6 +69,7 @@ void Collector::deactivate()
         if (!g.expired()) {
             g.lock()->onEntityAdded -= { index(), addEntityCache_ };
             g.lock()->onEntityRemoved -= { index(), addEntityCache_ };
+            g.lock()->onEntityUpdated -= { index(), updateEntityCache_ };
         }
     }
 
@@ -79,8 +86,19 @@ void Collector::clearCollectedEntities()
     collectedEntities_.clear();
 }
 
-void Collector::addEntity(Group::SharedPtr group, EntityPtr entity, ComponentId index, IComponent* component)
+void Collector::collect(const EntityPtr& entity)
 {
     collectedEntities_.insert(entity);
+    ENTITAS_COUNT(CollectorInserts);
+}
+
+void Collector::addEntity(const Group::SharedPtr& group, const EntityPtr& entity, ComponentId index, IComponent* component)
+{
+    collect(entity);
+}
+
+void Collector::updateEntity(const Group::SharedPtr& group, const EntityPtr& entity, ComponentId index, IComponent* previousComponent, IComponent* newComponent)
+{
+    collect(entity);
 }
 }
@@ -9,8 +9,8 @@
 #include "Entity.hpp"
 #include "Group.hpp"
 #include "GroupEventType.hpp"
+#include "PoolAllocator.hpp"
 #include <functional>
-#include <unordered_set>
 #include <vector>
 
 namespace entitas {
@@ -39,7 +39,7 @@ protected:
 /// and collects changed entities based on the specified groupEvent.
 class Collector : public Indexed {
 public:
-    using CollectedEntities = std::unordered_set<EntityPtr>;
+    using CollectedEntities = PooledSet<EntityPtr>;
     /// Creates a Collector and will collect changed entities
     /// based on the specified eventType.
     Collector(Group::WeakPtr group, const GroupEventType eventType);
@@ -47,7 +47,7 @@ public:
     /// Creates a Collector and will collect changed entities
     /// based on the specified eventTypes.
     Collector(std::vector<Group::WeakPtr>&& groups, std::vector<GroupEventType>&& eventTypes);
-    ~Collector();
+    virtual ~Collector();
 
     void activate();
     void deactivate();
@@ -60,8 +60,13 @@ public:
 
     void clearCollectedEntities();
 
+protected:
+    /// Called for every entity the groups report, stores it in the set
+    virtual void collect(const EntityPtr& entity);
+
 private:
-    void addEntity(Group::SharedPtr group, EntityPtr entity, ComponentId index, IComponent* component);
+    void addEntity(const Group::SharedPtr& group, const EntityPtr& entity, ComponentId index, IComponent* component);
+    void updateEntity(const Group::SharedPtr& group, const EntityPtr& entity, ComponentId index, IComponent* previousComponent, IComponent* newComponent);
     /// We store collected entities here
     CollectedEntities collectedEntities_;
     /// Groups that are used to 'collect' entities
@@ -69,6 +74,8 @@ private:
 
     std::vector<GroupEventType> eventTypes_;
     /// This is a callback that will be called by group and will save changes in 'collectedEntities_'
-    std::function<void(Group::SharedPtr, EntityPtr, ComponentId, IComponent*)> addEntityCache_;
+    std::function<void(const Group::SharedPtr&, const EntityPtr&, ComponentId, IComponent*)> addEntityCache_;
+    /// Replaced components only fire the group's onEntityUpdated
+    std::function<void(const Group::SharedPtr&, const EntityPtr&, ComponentId, IComponent*, IComponent*)> updateEntityCache_;
 };
 }
@@ -0,0 +1,57 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#include "CommandBuffer.hpp"
+#include "Context.hpp"
+#include "FlightRecorder.hpp"
+
+namespace entitas {
+
+void CommandBuffer::destroyEntity(const EntityPtr& entity)
+{
+    auto generation = entity->getGeneration();
+    commands_.emplace_back([entity, generation](Context* context) {
+        if (entity->isEnabled() && entity->getGeneration() == generation) {
+            context->destroyEntity(entity);
+        }
+    });
+}
+
+void CommandBuffer::createEntity(EntityInit init)
+{
+    commands_.emplace_back([init](Context* context) {
+        auto entity = context->createEntity();
+        if (init) {
+            init(entity);
+        }
+    });
+}
+
+void CommandBuffer::playback(Context* context)
+{
+    ENTITAS_RECORD_BULK("CommandBuffer.playback", commands_.size());
+    // Entity init callbacks might record more commands
+    for (std::size_t i = 0; i < commands_.size(); ++i) {
+        auto command = std::move(commands_[i]);
+        command(context);
+    }
+
+    commands_.clear();
+}
+
+void CommandBuffer::clear()
+{
+    commands_.clear();
+}
+
+bool CommandBuffer::empty() const
+{
+    return commands_.empty();
+}
+
+auto CommandBuffer::size() const -> std::size_t
+{
+    return commands_.size();
+}
+}
@@ -0,0 +1,88 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "Entity.hpp"
+#include <functional>
+#include <vector>
+
+namespace entitas {
+class Context;
+
+/// Records structural changes to be applied later on the thread owning the
+/// context, e.g. from the chunks of a parallel reactive system.
+/// Recording never touches the context or the entities.
+///
+/// Commands are applied in the order they were recorded. Commands for an
+/// entity which got destroyed (or destroyed and reused) in the meantime
+/// are skipped.
+class CommandBuffer {
+public:
+    using EntityInit = std::function<void(const EntityPtr& entity)>;
+
+    template <typename T, typename... TArgs>
+    inline void add(const EntityPtr& entity, TArgs... args);
+    template <typename T, typename... TArgs>
+    inline void replace(const EntityPtr& entity, TArgs... args);
+    template <typename T>
+    inline void remove(const EntityPtr& entity);
+    /// Reports a component written in place as replaced, like entity.modify()
+    template <typename T>
+    inline void markModified(const EntityPtr& entity);
+
+    void destroyEntity(const EntityPtr& entity);
+    /// The entity is created on playback and passed to 'init'
+    void createEntity(EntityInit init);
+
+    /// Applies and clears the recorded commands
+    void playback(Context* context);
+    void clear();
+    bool empty() const;
+    auto size() const -> std::size_t;
+
+private:
+    using Command = std::function<void(Context* context)>;
+
+    template <typename F>
+    inline void record(const EntityPtr& entity, F fn);
+
+    std::vector<Command> commands_;
+};
+
+template <typename F>
+void CommandBuffer::record(const EntityPtr& entity, F fn)
+{
+    auto generation = entity->getGeneration();
+    commands_.emplace_back([entity, generation, fn](Context*) {
+        if (entity->isEnabled() && entity->getGeneration() == generation) {
+            fn(entity);
+        }
+    });
+}
+
+template <typename T, typename... TArgs>
+void CommandBuffer::add(const EntityPtr& entity, TArgs... args)
+{
+    record(entity, [args...](const EntityPtr& e) { e->add<T>(args...); });
+}
+
+template <typename T, typename... TArgs>
+void CommandBuffer::replace(const EntityPtr& entity, TArgs... args)
+{
+    record(entity, [args...](const EntityPtr& e) { e->replace<T>(args...); });
+}
+
+template <typename T>
+void CommandBuffer::remove(const EntityPtr& entity)
+{
+    record(entity, [](const EntityPtr& e) { e->remove<T>(); });
+}
+
+template <typename T>
+void CommandBuffer::markModified(const EntityPtr& entity)
+{
+    record(entity, [](const EntityPtr& e) { e->modify<T>(); });
+}
+}
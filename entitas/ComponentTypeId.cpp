@@ -3,8 +3,46 @@
 // MIT License web page: https://opensource.org/licenses/MIT
 
 #include "ComponentTypeId.hpp"
+#include <stdexcept>
 
 namespace entitas
 {
 size_t ComponentTypeId::counter_ = 0;
+
+bool ComponentTypeId::isTag(const ComponentId index)
+{
+    return getTagInstance(index) != nullptr;
+}
+
+IComponent* ComponentTypeId::getTagInstance(const ComponentId index)
+{
+    return getTypes()[index].tagInstance;
+}
+
+size_t ComponentTypeId::getSize(const ComponentId index)
+{
+    return getTypes()[index].size;
+}
+
+const char* ComponentTypeId::getName(const ComponentId index)
+{
+    return getTypes()[index].name;
+}
+
+ComponentId ComponentTypeId::registerType(IComponent* tagInstance, size_t size, const char* name)
+{
+    if (counter_ >= ENTITAS_MAX_COMPONENTS) {
+        throw std::runtime_error("Error, too many component types, increase ENTITAS_MAX_COMPONENTS");
+    }
+
+    getTypes().push_back(TypeInfo{ tagInstance, size, name });
+    return static_cast<ComponentId>(counter_++);
+}
+
+std::vector<ComponentTypeId::TypeInfo>& ComponentTypeId::getTypes()
+{
+    // Function local so it is ready even if ids are requested during static initialization
+    static std::vector<TypeInfo> types;
+    return types;
+}
 }
@@ -6,15 +6,25 @@
 #pragma once
 
 #include "IComponent.hpp"
-#include <vector>
+#include <bitset>
 #include <cstddef>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
 
 #define COMPONENT_GET_TYPE_ID(COMPONENT_CLASS) \
     entitas::ComponentTypeId::get<COMPONENT_CLASS>()
 
+/// Maximum number of component types, every entity keeps one bit per type
+#ifndef ENTITAS_MAX_COMPONENTS
+#define ENTITAS_MAX_COMPONENTS 64
+#endif
+
 namespace entitas {
 using ComponentId = unsigned int;
 using ComponentIdList = std::vector<ComponentId>;
+/// One bit per ComponentId, set if an entity has that component
+using ComponentMask = std::bitset<ENTITAS_MAX_COMPONENTS>;
 
 struct ComponentTypeId {
 public:
@@ -24,13 +34,47 @@ public:
         static_assert((std::is_base_of<IComponent, T>::value && !std::is_same<IComponent, T>::value),
             "Class type must be derived from IComponent");
 
-        static ComponentId id = counter_++;
+        static ComponentId id = registerType(isTag<T>() ? getTagInstance<T>() : nullptr, sizeof(T), typeid(T).name());
         return id;
     }
 
+    /// Components without data members (markers like "Selected" or "Dead")
+    /// are tags. Entities only keep a bit for them, they are never
+    /// allocated nor pooled and all entities share a single instance.
+    template <typename T>
+    static constexpr bool isTag()
+    {
+        return std::is_empty<T>::value;
+    }
+
+    static bool isTag(const ComponentId index);
+    /// Returns the instance shared by all entities for a tag,
+    /// nullptr for components with data.
+    static IComponent* getTagInstance(const ComponentId index);
+
     static size_t count() { return counter_; }
+    /// sizeof() of the component type
+    static size_t getSize(const ComponentId index);
+    /// As given by typeid, mangled by most compilers
+    static const char* getName(const ComponentId index);
 
 private:
+    template <typename T>
+    static IComponent* getTagInstance()
+    {
+        static T instance;
+        return &instance;
+    }
+
+    struct TypeInfo {
+        IComponent* tagInstance;
+        size_t size;
+        const char* name;
+    };
+
+    static ComponentId registerType(IComponent* tagInstance, size_t size, const char* name);
+    static std::vector<TypeInfo>& getTypes();
+
     static size_t counter_;
 };
 }
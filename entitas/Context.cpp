@@ -5,18 +5,22 @@
 
 #include "Context.hpp"
 #include "Entity.hpp"
+#include "EntityIndex.hpp"
+#include "FlightRecorder.hpp"
 #include "Functional.hpp"
 #include "ISystem.hpp"
 #include "ReactiveSystem.hpp"
+#include "SharedCollector.hpp"
 #include <algorithm>
 #include <assert.h>
+#include <iterator>
 #include <utility>
 
 namespace entitas {
 Context::Context(const unsigned int startCreationIndex)
+    : slab_{ this }
 {
     creationIndex_ = startCreationIndex;
-    onEntityReleasedCache_ = std::bind(&Context::onEntityReleased, this, std::placeholders::_1);
 }
 
 Context::~Context()
@@ -29,11 +33,6 @@ Context::~Context()
         // Warning, some entities remain undestroyed in the pool destruction !"
     }
 
-    while (!reusableEntities_.empty()) {
-        delete reusableEntities_.top();
-        reusableEntities_.pop();
-    }
-
     for (auto& pair : componentPools_) {
         auto componentPool = pair.second;
 
@@ -44,45 +43,35 @@ Context::~Context()
     }
 }
 /// Creates a new entity or gets a reusable entity from the
-/// internal ObjectPool for entities.
+/// internal slab for entities, lowest free slot first.
 auto Context::createEntity() -> EntityPtr
 {
-    EntityPtr entity;
-
-    if (reusableEntities_.size() > 0) {
-        entity = EntityPtr(reusableEntities_.top(), [](Entity* entity) {
-            entity->onReleased(entity);
-        });
-        reusableEntities_.pop();
-    } else {
-        entity = EntityPtr(new Entity(componentPools_), [](Entity* entity) {
-            entity->onReleased(entity);
-        });
-    }
+    // Entities notify the context directly about component changes,
+    // so there is nothing to subscribe to here
+    // The control block is recycled like the slot
+    auto entity = EntityPtr(slab_.acquire(), [lifetime = slab_.getLifetime()](Entity* entity) {
+        entity->onReleased(entity);
+        if (lifetime->context) {
+            lifetime->context->onEntityReleased(entity);
+        } else {
+            // Released after the context, nothing is reused anymore
+            entity->~Entity();
+        }
+    }, NodePoolAllocator<Entity>());
 
     entity->setInstance(entity);
     entity->reactivate(creationIndex_++);
 
-    entities_.insert(entity);
+    ++count_;
     entitiesCache_.clear();
-    // TODO This can be optimized by making less generic since 'onComponentAdded' will have usually only 1 callback
-    entity->onComponentAdded += { entity->uuid_,
-        [this](EntityPtr entity, ComponentId index, IComponent* component) {
-            updateGroupsComponentAddedOrRemoved(entity, index, component);
-        } };
-    entity->onComponentRemoved += { entity->uuid_,
-        [this](EntityPtr entity, ComponentId index, IComponent* component) {
-            updateGroupsComponentAddedOrRemoved(entity, index, component);
-        } };
-    entity->onComponentReplaced += { entity->uuid_,
-        [this](EntityPtr entity, ComponentId index, IComponent* previousComponent, IComponent* newComponent) {
-            updateGroupsComponentReplaced(entity, index, previousComponent, newComponent);
-        } };
+    ENTITAS_COUNT(EntitiesCreated);
 
     entity->onReleased.clear();
-    entity->onReleased += { entity->uuid_, onEntityReleasedCache_ };
 
     onEntityCreated(this, entity);
+    if (!onEntitiesCreated.empty()) {
+        createdEntities_.push_back(entity);
+    }
 
     assert(hasEntity(entity));
     return entity;
@@ -90,44 +79,50 @@ auto Context::createEntity() -> EntityPtr
 
 bool Context::hasEntity(const EntityPtr& entity) const
 {
-    //return std::find(entities_.begin(), entities_.end(), entity) != entities_.end();
-    return doesExist(entities_, entity);
+    return entity && entity->context_ == this && entity->isEnabled();
 }
 
 void Context::destroyEntity(EntityPtr entity)
 {
-    auto removed = entities_.erase(entity);
-
-    if (!removed) {
+    if (!hasEntity(entity)) {
         throw std::runtime_error("Error, cannot destroy entity. Context does not contain entity.");
     }
 
+    --count_;
     entitiesCache_.clear();
+    ENTITAS_COUNT(EntitiesDestroyed);
 
     onEntityWillBeDestroyed(this, entity);
     entity->destroy();
     onEntityDestroyed(this, entity);
+    if (!onEntitiesDestroyed.empty()) {
+        // Retained until the batch got delivered
+        destroyedEntities_.push_back(entity);
+    }
 
-    if (entity.use_count() == 1) {
-        entity->onReleased -= { entity->uuid_, onEntityReleasedCache_ };
-        reusableEntities_.push(entity.get());
-    } else {
+    // Otherwise the slot is released as soon as 'entity' goes out of scope
+    if (entity.use_count() != 1) {
         retainedEntities_.insert(entity.get());
     }
 }
 
 void Context::destroyAllEntities()
 {
-    {
-        auto entitiesTemp = Entities(entities_.begin(), entities_.end());
+    // Release unique entities so they can be reused like any other
+    uniqueEntities_.clear();
 
-        while (!entities_.empty()) {
-            destroyEntity(entitiesTemp.back());
+    {
+        auto entitiesTemp = getEntities();
+        ENTITAS_RECORD_BULK("Context.destroyAllEntities", entitiesTemp.size());
+
+        while (!entitiesTemp.empty()) {
+            // A handler might have destroyed it already
+            if (entitiesTemp.back()->isEnabled()) {
+                destroyEntity(entitiesTemp.back());
+            }
             entitiesTemp.pop_back();
         }
     }
-    // This should be empty by now
-    entities_.clear();
 
     if (!retainedEntities_.empty()) {
         // Try calling Context.clearGroups() and SystemContainer.clearReactiveSystems() before calling context.destroyAllEntities() to avoid memory leaks
@@ -137,24 +132,37 @@ void Context::destroyAllEntities()
 
 Entities& Context::getEntities()
 {
-    if (entitiesCache_.empty()) {
-        entitiesCache_ = Entities(entities_.begin(), entities_.end());
+    if (entitiesCache_.empty() && count_ > 0) {
+        // Slot order, so entities come out the way they sit in memory
+        entitiesCache_.reserve(count_);
+        slab_.forEachRecord([this](const EntityRecord& record) {
+            if (record.enabled) {
+                entitiesCache_.push_back(record.entity->instance_);
+            }
+        });
     }
     return entitiesCache_;
 }
 
-Entities& Context::getEntities(const Matcher matcher)
+Entities& Context::getEntities(const Matcher& matcher)
 {
     return getGroup(matcher)->getEntities();
 }
 
-auto Context::getGroup(Matcher matcher) -> Group::SharedPtr
+auto Context::getGroup(const Matcher& matcher) -> Group::SharedPtr
 {
     Group::SharedPtr group;
     auto it = groups_.find(matcher);
     if (it == groups_.end()) {
         group.reset(new Group(matcher));
         group->setInstance(group);
+        // Out of bits the group keeps track of its entities on its own
+        if (groupList_.size() < ENTITAS_MAX_GROUPS) {
+            group->groupIndex_ = static_cast<unsigned>(groupList_.size());
+        }
+        group->usage_.createdFrame = frame_;
+        group->usage_.lastReadFrame = frame_;
+        groupList_.push_back(group.get());
 
         // 'Handle' all entities that are already in a context
         // Thus if the group is created later it will still be able to 'handle'
@@ -163,10 +171,18 @@ auto Context::getGroup(Matcher matcher) -> Group::SharedPtr
         for_each(entities,
             [=, &group](auto& e) { group->handleEntitySilently(e); });
 
-        groups_[group->getMatcher()] = group;
-
-        for_each(matcher.getIndices(),
-            [&, this](auto index) { groupsForIndex_[index].push_back(group); });
+        // Nodes of 'groups_' don't move, the group can point to its entry
+        auto& owner = groups_[group->getMatcher()];
+        owner = group;
+        group->owner_ = &owner;
+
+        for_each(group->matcher_.getIndices(),
+            [&, this](auto index) {
+                if (index >= groupsForIndex_.size()) {
+                    groupsForIndex_.resize(index + 1);
+                }
+                groupsForIndex_[index].push_back(group.get());
+            });
 
         onGroupCreated(this, group);
     } else {
@@ -183,13 +199,86 @@ void Context::clearGroups()
         onGroupCleared(this, it.second);
     }
 
+    // Groups still referenced outside stay usable but empty, they no
+    // longer hold on to the context's entities
+    for (const auto& it : groups_) {
+        it.second->owner_ = nullptr;
+        it.second->groupIndex_ = Group::kNoIndex;
+        it.second->entities_.clear();
+        it.second->entitiesCache_.clear();
+    }
+
     groups_.clear();
+    groupsForIndex_.clear();
+    groupList_.clear();
+    // They were listening to the groups that are gone
+    sharedCollectors_.clear();
 
-    for (auto& pair : groupsForIndex_) {
-        pair.second.clear();
+    slab_.forEachRecord([](EntityRecord& record) { record.groups.reset(); });
+}
+
+auto Context::getSharedCollector(const std::vector<TriggerOnEvent>& triggers) -> std::shared_ptr<SharedCollector>
+{
+    // Same triggers in any order, each as many times
+    auto sameTriggers = [&triggers](const std::vector<TriggerOnEvent>& other) {
+        if (other.size() != triggers.size()) {
+            return false;
+        }
+
+        return std::all_of(other.begin(), other.end(), [&](const TriggerOnEvent& o) {
+            auto isO = [&o](const TriggerOnEvent& t) { return t.eventType == o.eventType && t.trigger == o.trigger; };
+            return std::count_if(other.begin(), other.end(), isO) == std::count_if(triggers.begin(), triggers.end(), isO);
+        });
+    };
+
+    sharedCollectors_.erase(std::remove_if(sharedCollectors_.begin(), sharedCollectors_.end(),
+                                [](const auto& pair) { return pair.second.expired(); }),
+        sharedCollectors_.end());
+
+    for (const auto& pair : sharedCollectors_) {
+        if (sameTriggers(pair.first)) {
+            return pair.second.lock();
+        }
     }
 
-    groupsForIndex_.clear();
+    auto groups = std::vector<Group::WeakPtr>();
+    auto eventTypes = std::vector<GroupEventType>();
+    for (const auto& trigger : triggers) {
+        groups.push_back(getGroup(trigger.trigger));
+        eventTypes.push_back(trigger.eventType);
+    }
+
+    auto collector = std::make_shared<SharedCollector>(std::move(groups), std::move(eventTypes));
+    sharedCollectors_.emplace_back(triggers, collector);
+    return collector;
+}
+
+void Context::addEntityIndex(const std::string& name, std::shared_ptr<IEntityIndex> entityIndex)
+{
+    if (entityIndices_.find(name) != entityIndices_.end()) {
+        throw std::runtime_error("Error, cannot add entity index, an index with the same name already exists");
+    }
+
+    entityIndices_[name] = entityIndex;
+}
+
+auto Context::getEntityIndex(const std::string& name) const -> std::shared_ptr<IEntityIndex>
+{
+    auto it = entityIndices_.find(name);
+    if (it == entityIndices_.end()) {
+        throw std::runtime_error("Error, cannot get entity index, there is no index with that name");
+    }
+
+    return it->second;
+}
+
+void Context::deactivateAndRemoveEntityIndices()
+{
+    for (auto& pair : entityIndices_) {
+        pair.second->deactivate();
+    }
+
+    entityIndices_.clear();
 }
 
 void Context::resetCreationIndex()
@@ -212,19 +301,220 @@ void Context::clearComponentPools()
 
 void Context::reset()
 {
+    deactivateAndRemoveEntityIndices();
     clearGroups();
+    // Also frees the entities, each one references itself until destroyed
     destroyAllEntities();
     resetCreationIndex();
+
+    createdEntities_.clear();
+    destroyedEntities_.clear();
+    dirtyEntities_.clear();
+}
+
+void Context::flush()
+{
+    flushDirtyComponents();
+
+    // Take everything first, changes made by the handlers are delivered
+    // by the next flush
+    deliveredCreatedEntities_.swap(createdEntities_);
+    deliveredDestroyedEntities_.swap(destroyedEntities_);
+    for (auto group : groupList_) {
+        group->takeChanges();
+        group->updateUsage(frame_);
+    }
+    ++frame_;
+    ENTITAS_RECORD_BULK("Context.flush", deliveredCreatedEntities_.size() + deliveredDestroyedEntities_.size());
+
+    if (!deliveredCreatedEntities_.empty()) {
+        onEntitiesCreated(this, deliveredCreatedEntities_);
+        deliveredCreatedEntities_.clear();
+    }
+
+    // Handlers might create groups, those have nothing to deliver yet
+    for (size_t i = 0; i < groupList_.size(); ++i) {
+        groupList_[i]->flush();
+    }
+
+    if (!deliveredDestroyedEntities_.empty()) {
+        onEntitiesDestroyed(this, deliveredDestroyedEntities_);
+        deliveredDestroyedEntities_.clear();
+    }
+}
+
+auto Context::getCounters() -> Counters
+{
+    return readCounters();
+}
+
+void Context::resetCounters()
+{
+    entitas::resetCounters();
+}
+
+auto Context::getMemoryReport() -> MemoryReport
+{
+    using memory::getHeapBytes;
+    MemoryReport report;
+    auto& totals = report.current;
+
+    auto getDelegateBytes = [](const Group& group) {
+        return group.onEntityAdded.getMemoryBytes() + group.onEntityUpdated.getMemoryBytes() + group.onEntityRemoved.getMemoryBytes()
+            + group.onEntitiesAdded.getMemoryBytes() + group.onEntitiesUpdated.getMemoryBytes() + group.onEntitiesRemoved.getMemoryBytes();
+    };
+
+    // Entities, and the components they hold
+    std::vector<std::size_t> liveCounts(ComponentTypeId::count(), 0);
+    totals.entities = slab_.getMemoryBytes();
+    slab_.forEachRecord([&](const EntityRecord& record) {
+        const auto& entity = *record.entity;
+        totals.entities += getHeapBytes(entity.components_);
+        totals.delegates += entity.onComponentAdded.getMemoryBytes() + entity.onComponentReplaced.getMemoryBytes()
+            + entity.onComponentRemoved.getMemoryBytes() + entity.onReleased.getMemoryBytes();
+
+        if (record.enabled) {
+            for (std::size_t i = 0; i < liveCounts.size(); ++i) {
+                liveCounts[i] += record.signature.test(i) ? 1 : 0;
+            }
+        }
+    });
+    report.entityCount = count_;
+    report.entitySlots = slab_.capacity();
+
+    for (ComponentId index = 0; index < liveCounts.size(); ++index) {
+        if (ComponentTypeId::isTag(index)) {
+            continue;
+        }
+
+        auto pool = componentPools_.find(index);
+        auto pooledCount = pool == componentPools_.end() ? 0 : pool->second.size();
+        report.components.push_back(MemoryReport::ComponentUsage{
+            index, ComponentTypeId::getName(index), ComponentTypeId::getSize(index), liveCounts[index], pooledCount });
+
+        const auto& usage = report.components.back();
+        totals.components += usage.getLiveBytes() + usage.getPooledBytes();
+        totals.context += pooledCount * sizeof(IComponent*);
+    }
+
+    for (auto group : groupList_) {
+        auto changeBytes = std::size_t{ 0 };
+        for (auto changes : { &group->addedChanges_, &group->updatedChanges_, &group->removedChanges_ }) {
+            changeBytes += getHeapBytes(changes->pending) + getHeapBytes(changes->delivered);
+        }
+
+        report.groups.push_back(MemoryReport::GroupUsage{
+            group->matcher_, group->entities_.size(), getHeapBytes(group->entities_), getHeapBytes(group->entitiesCache_), changeBytes });
+
+        const auto& usage = report.groups.back();
+        totals.groups += usage.memberBytes + usage.cacheBytes + usage.changeBytes;
+        totals.delegates += getDelegateBytes(*group);
+    }
+
+    for (const auto& pair : sharedCollectors_) {
+        if (auto collector = pair.second.lock()) {
+            totals.collectors += collector->getMemoryBytes();
+        }
+        totals.collectors += getHeapBytes(pair.first);
+    }
+
+    totals.delegates += onEntityCreated.getMemoryBytes() + onEntityWillBeDestroyed.getMemoryBytes() + onEntityDestroyed.getMemoryBytes()
+        + onEntitiesCreated.getMemoryBytes() + onEntitiesDestroyed.getMemoryBytes()
+        + onGroupCreated.getMemoryBytes() + onGroupCleared.getMemoryBytes();
+
+    totals.context += getHeapBytes(groups_) + getHeapBytes(groupList_) + getHeapBytes(groupsForIndex_)
+        + getHeapBytes(retainedEntities_) + getHeapBytes(componentPools_) + getHeapBytes(sharedCollectors_)
+        + getHeapBytes(uniqueEntities_) + getHeapBytes(entitiesCache_) + getHeapBytes(dirtyEntities_)
+        + getHeapBytes(flushedDirtyEntities_) + getHeapBytes(createdEntities_) + getHeapBytes(destroyedEntities_)
+        + getHeapBytes(deliveredCreatedEntities_) + getHeapBytes(deliveredDestroyedEntities_);
+    for (const auto& groups : groupsForIndex_) {
+        totals.context += getHeapBytes(groups);
+    }
+    for (const auto& entities : dirtyEntities_) {
+        totals.context += getHeapBytes(entities);
+    }
+
+    memoryPeak_.components = std::max(memoryPeak_.components, totals.components);
+    memoryPeak_.groups = std::max(memoryPeak_.groups, totals.groups);
+    memoryPeak_.entities = std::max(memoryPeak_.entities, totals.entities);
+    memoryPeak_.collectors = std::max(memoryPeak_.collectors, totals.collectors);
+    memoryPeak_.delegates = std::max(memoryPeak_.delegates, totals.delegates);
+    memoryPeak_.context = std::max(memoryPeak_.context, totals.context);
+    memoryPeakTotal_ = std::max(memoryPeakTotal_, totals.getTotal());
+    report.peak = memoryPeak_;
+    report.peakTotal = memoryPeakTotal_;
+    report.nodePoolBytes = getNodePoolBytes();
+    report.nodePoolPeakBytes = getNodePoolPeakBytes();
+
+    return report;
+}
+
+auto Context::getGroupUsageReport(const GroupUsageReport::Thresholds& thresholds) const -> GroupUsageReport
+{
+    GroupUsageReport report;
+    report.frame = frame_;
+
+    for (auto group : groupList_) {
+        const auto& usage = group->usage_;
+        GroupUsageReport::GroupUsage g;
+        g.matcher = group->matcher_;
+        g.entityCount = group->entities_.size();
+        g.usage = usage;
+        g.subscribersCount = group->getSubscribersCount();
+        // Besides the context
+        g.holdersCount = group->owner_->use_count() - 1;
+        // Reads since the last flush happen in the current frame
+        g.idleFrames = usage.reads != group->readsAtFrame_ ? 0 : frame_ - usage.lastReadFrame;
+
+        auto churn = g.getChurn();
+        g.dead = g.subscribersCount == 0 && g.idleFrames >= thresholds.deadFrames;
+        g.churning = !g.dead && g.subscribersCount == 0 && churn >= thresholds.minChurn
+            && churn > thresholds.churnPerRead * std::max<unsigned long>(usage.reads, 1);
+        report.groups.push_back(g);
+    }
+
+    auto sorted = [](ComponentIdList indices) {
+        std::sort(indices.begin(), indices.end());
+        return indices;
+    };
+    auto difference = [&sorted](const ComponentIdList& left, const ComponentIdList& right) {
+        auto l = sorted(left);
+        auto r = sorted(right);
+        ComponentIdList apart;
+        std::set_symmetric_difference(l.begin(), l.end(), r.begin(), r.end(), std::back_inserter(apart));
+        return apart.size();
+    };
+
+    for (std::size_t i = 0; i < groupList_.size(); ++i) {
+        for (std::size_t j = i + 1; j < groupList_.size(); ++j) {
+            const auto& first = *groupList_[i];
+            const auto& second = *groupList_[j];
+            auto apart = difference(first.matcher_.getAllOfIndices(), second.matcher_.getAllOfIndices())
+                + difference(first.matcher_.getAnyOfIndices(), second.matcher_.getAnyOfIndices())
+                + difference(first.matcher_.getNoneOfIndices(), second.matcher_.getNoneOfIndices());
+
+            auto sameEntities = !first.entities_.empty() && first.entities_.size() == second.entities_.size()
+                && std::all_of(first.entities_.begin(), first.entities_.end(), [&second](Entity* entity) {
+                       return second.containsEntity(entity);
+                   });
+
+            if (apart == 1 || sameEntities) {
+                report.nearDuplicates.push_back(GroupUsageReport::NearDuplicate{ i, j, apart, sameEntities });
+            }
+        }
+    }
+
+    return report;
 }
 
 auto Context::count() const -> unsigned int
 {
-    return entities_.size();
+    return count_;
 }
 
 auto Context::getReusableEntitiesCount() const -> unsigned int
 {
-    return reusableEntities_.size();
+    return slab_.getFreeCount();
 }
 
 auto Context::getRetainedEntitiesCount() const -> unsigned int
@@ -251,57 +541,139 @@ auto Context::createSystem(std::shared_ptr<ISystem> system) -> std::shared_ptr<I
     return system;
 }
 
-void Context::updateGroupsComponentAddedOrRemoved(EntityPtr entity, ComponentId index, IComponent* component)
+auto Context::getUniqueSlot(const ComponentId index) const -> const EntityPtr&
+{
+    static const EntityPtr none;
+
+    if (index >= uniqueEntities_.size()) {
+        return none;
+    }
+
+    // The entity might have been destroyed directly through destroyEntity()
+    const auto& entity = uniqueEntities_[index];
+    return (entity && entity->isEnabled()) ? entity : none;
+}
+
+void Context::updateGroupsComponentAddedOrRemoved(const EntityPtr& entity, ComponentId index, IComponent* component)
 {
-    if (groupsForIndex_.find(index) == groupsForIndex_.end()) {
+    if (index >= groupsForIndex_.size()) {
         return;
     }
 
     // All groups that contain entities with a given component
-    auto& groups = groupsForIndex_[index];
+    auto groupsCount = groupsForIndex_[index].size();
 
-    if (!groups.empty()) {
-        // Collect all the events that need to be processed (e.g. onAdded
-        std::vector<Group::GroupChanged*> events;
-        for (int i = 0, groupsCount = groups.size(); i < groupsCount; ++i) {
-            events.push_back(groups[i].lock()->handleEntity(entity));
+    if (groupsCount > 0) {
+        // Collect all the events that need to be processed (e.g. onAdded)
+        auto first = groupEvents_.size();
+        for (std::size_t i = 0; i < groupsCount; ++i) {
+            groupEvents_.push_back(groupsForIndex_[index][i]->handleEntity(entity));
         }
 
-        for (int i = 0, eventsCount = events.size(); i < eventsCount; ++i) {
-            auto cb = events[i];
+        // Handlers might create groups, which are appended to the lists
+        // and already handled the entity, so the lists are looked up anew
+        // and only the groups of the snapshot are notified
+        for (std::size_t i = 0; i < groupsCount && hasGroupForIndex(index, i); ++i) {
+            auto cb = groupEvents_[first + i];
             if (cb)
-                (*cb)(groups[i].lock(), entity, index, component);
+                groupsForIndex_[index][i]->notifyEntity(cb, entity, index, component);
         }
-
-#if 0
-        for_each(groups,
-            [=](const auto& g) {
-                auto groupChangedEvent = g.lock()->handleEntity(entity);
-                if (groupChangedEvent)
-                    (*groupChangedEvent)(g.lock(), entity, index, component);
-            });
-#endif
+        groupEvents_.resize(first);
     }
 }
 
-void Context::updateGroupsComponentReplaced(EntityPtr entity, ComponentId index, IComponent* previousComponent, IComponent* newComponent)
+void Context::updateGroupsComponentReplaced(const EntityPtr& entity, ComponentId index, IComponent* previousComponent, IComponent* newComponent)
 {
-    if (groupsForIndex_.find(index) == groupsForIndex_.end()) {
+    if (index >= groupsForIndex_.size()) {
         return;
     }
-    //using namespace std;
-    auto& groups = groupsForIndex_[index];
-    for_each(groups,
-        [=](const auto& g) { g.lock()->updateEntity(entity, index, previousComponent, newComponent); });
+
+    // Same as above, groups created by the handlers are not notified
+    for (std::size_t i = 0, groupsCount = groupsForIndex_[index].size(); i < groupsCount && hasGroupForIndex(index, i); ++i) {
+        groupsForIndex_[index][i]->updateEntity(entity, index, previousComponent, newComponent);
+    }
+}
+
+bool Context::hasGroupForIndex(ComponentId index, std::size_t i) const
+{
+    // Handlers might have cleared the groups
+    return index < groupsForIndex_.size() && i < groupsForIndex_[index].size();
+}
+
+void Context::removeEntityFromGroups(const EntityPtr& entity)
+{
+    auto removeEntity = [&entity](Group* group) {
+        // Pass along one of the components the group matched the entity by
+        ComponentId index = 0;
+        IComponent* component = nullptr;
+        for (auto id : group->matcher_.getIndices()) {
+            if (entity->hasComponent(id)) {
+                index = id;
+                component = entity->getComponent(id);
+                break;
+            }
+        }
+
+        group->removeEntity(entity, index, component);
+    };
+
+    auto groups = entity->record_->groups;
+    auto count = static_cast<unsigned>(groupList_.size());
+
+    for (unsigned int i = 0; i < count && i < ENTITAS_MAX_GROUPS && groups.any(); ++i) {
+        if (!groups.test(i)) {
+            continue;
+        }
+        groups.reset(i);
+        removeEntity(groupList_[i]);
+    }
+
+    // Groups without a bit have to be asked
+    for (unsigned int i = ENTITAS_MAX_GROUPS; i < count; ++i) {
+        if (groupList_[i]->containsEntity(entity)) {
+            removeEntity(groupList_[i]);
+        }
+    }
+}
+
+void Context::markDirty(const EntityPtr& entity, ComponentId index)
+{
+    if (index >= dirtyEntities_.size()) {
+        dirtyEntities_.resize(index + 1);
+    }
+
+    dirtyEntities_[index].push_back(entity);
+}
+
+void Context::flushDirtyComponents()
+{
+    for (ComponentId index = 0; index < dirtyEntities_.size(); ++index) {
+        if (dirtyEntities_[index].empty()) {
+            continue;
+        }
+
+        // Entities modified again by the handlers are queued anew
+        flushedDirtyEntities_.swap(dirtyEntities_[index]);
+        for (const auto& entity : flushedDirtyEntities_) {
+            entity->dirty_.reset(index);
+
+            // It might have been destroyed or lost the component since.
+            // The previous value is gone, listeners keep what they need.
+            if (entity->isEnabled() && entity->hasComponent(index)) {
+                entity->replaceComponent(index, entity->getComponent(index));
+            }
+        }
+        flushedDirtyEntities_.clear();
+    }
 }
 
 void Context::onEntityReleased(Entity* entity)
 {
-    if (entity->enabled_) {
+    if (entity->isEnabled()) {
         throw std::runtime_error("Error, cannot release entity. Entity is not destroyed yet.");
     }
 
     retainedEntities_.erase(entity);
-    reusableEntities_.push(entity);
+    slab_.release(entity);
 }
 }
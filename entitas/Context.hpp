@@ -5,18 +5,29 @@
 
 #pragma once
 
+#include "Counters.hpp"
 #include "Entity.hpp"
+#include "EntitySlab.hpp"
 #include "Group.hpp"
+#include "GroupUsageReport.hpp"
+#include "MemoryReport.hpp"
+#include "TriggerOnEvent.hpp"
 #include <map>
+#include <string>
 #include <unordered_map>
 
 namespace entitas {
 class ISystem;
+class IEntityIndex;
+class SharedCollector;
 
 class Context {
+    friend class Entity;
+
 public:
     static const unsigned kStartCreationIndex = 1;
     Context(const unsigned int startCreationIndex = kStartCreationIndex);
+    /// Resets the context, see reset()
     ~Context();
 
     auto createEntity() -> EntityPtr;
@@ -25,17 +36,51 @@ public:
     void destroyAllEntities();
 
     Entities& getEntities();
-    Entities& getEntities(const Matcher matcher);
+    Entities& getEntities(const Matcher& matcher);
+
+    /// Unique components exist at most once per context (input state,
+    /// camera, config...). Each one lives on its own entity, so groups and
+    /// reactive systems see it change like any other component, but it is
+    /// reached through a slot indexed by component type instead of a group.
+    template <typename T, typename... TArgs>
+    inline auto setUnique(TArgs&&... args) -> EntityPtr;
+    /// Returns the unique component. Throws if it has not been set.
+    template <typename T>
+    inline auto unique() const -> T*;
+    template <typename T>
+    inline bool hasUnique() const;
+    /// Destroys the entity holding the unique component.
+    template <typename T>
+    inline void removeUnique();
+    template <typename T>
+    inline auto getUniqueEntity() const -> EntityPtr;
 
     /// Returns a group for the specified matcher.
     /// Calling context.GetGroup(matcher) with the same matcher will always
     /// return the same instance of the group.
-    auto getGroup(Matcher matcher) -> Group::SharedPtr;
+    auto getGroup(const Matcher& matcher) -> Group::SharedPtr;
 
     void clearGroups();
+
+    /// Returns the collector for the given triggers, shared by everyone
+    /// asking for the same set of matchers and event types while it is
+    /// alive. Reactive systems created by createSystem() use it.
+    auto getSharedCollector(const std::vector<TriggerOnEvent>& triggers) -> std::shared_ptr<SharedCollector>;
+
+    /// Registers an entity index under the given name.
+    /// It will be deactivated and removed when the context gets reset.
+    void addEntityIndex(const std::string& name, std::shared_ptr<IEntityIndex> entityIndex);
+    auto getEntityIndex(const std::string& name) const -> std::shared_ptr<IEntityIndex>;
+    template <typename T>
+    inline auto getEntityIndex(const std::string& name) const -> std::shared_ptr<T>;
+    void deactivateAndRemoveEntityIndices();
+
     void resetCreationIndex();
     void clearComponentPool(const ComponentId index);
     void clearComponentPools();
+    /// Must destroy every entity: an enabled entity holds a strong
+    /// reference to itself that only destroying it drops, so an entity
+    /// left enabled would never be freed.
     void reset();
 
     auto count() const -> unsigned int;
@@ -48,39 +93,162 @@ public:
     template <typename T>
     inline auto createSystem() -> std::shared_ptr<ISystem>;
 
-    using EntityChanged = Delegate<void(Context* context, EntityPtr entity)>;
-    using GroupChanged = Delegate<void(Context* context, Group::SharedPtr group)>;
+    using EntityChanged = Delegate<void(Context* context, const EntityPtr& entity)>;
+    using GroupChanged = Delegate<void(Context* context, const Group::SharedPtr& group)>;
 
     EntityChanged onEntityCreated;
     EntityChanged onEntityWillBeDestroyed;
     EntityChanged onEntityDestroyed;
 
+    using EntitiesChanged = Delegate<void(Context* context, const Entities& entities)>;
+
+    /// Batched versions of onEntityCreated and onEntityDestroyed.
+    /// Entities are only recorded while there are subscribers and are
+    /// delivered all at once by flush(). Created entities might be
+    /// destroyed by then.
+    EntitiesChanged onEntitiesCreated;
+    EntitiesChanged onEntitiesDestroyed;
+
+    /// Reports the components modified in place through entity.modify()
+    /// as replaced, then delivers all batched context and group events
+    /// recorded since the last flush. Usually called once per frame after
+    /// the systems executed.
+    /// Changes made by the handlers are delivered by the next flush.
+    void flush();
+
+    /// What the engine did since the last reset, see Counters.hpp. Counts
+    /// are shared by all contexts and summed over all threads, they stay
+    /// at zero unless built with ENTITAS_COUNTERS.
+    static auto getCounters() -> Counters;
+    /// Usually called once per frame to get per-frame counts
+    static void resetCounters();
+
+    /// Bytes held per component type, group and engine structure, see
+    /// MemoryReport. Walks every entity, meant for diagnostics rather than
+    /// every frame. Also updates the high-water marks, which only see
+    /// the reports made.
+    auto getMemoryReport() -> MemoryReport;
+    /// Reads, churn and subscribers of every group, flagging the groups
+    /// that cost updates without being used and near duplicate matchers.
+    /// Frames are counted by flush().
+    auto getGroupUsageReport(const GroupUsageReport::Thresholds& thresholds = GroupUsageReport::Thresholds()) const -> GroupUsageReport;
+
     GroupChanged onGroupCreated;
     GroupChanged onGroupCleared;
 
 private:
-    void updateGroupsComponentAddedOrRemoved(EntityPtr entity, ComponentId index, IComponent* component);
-    void updateGroupsComponentReplaced(EntityPtr entity, ComponentId index, IComponent* previousComponent, IComponent* newComponent);
+    auto getUniqueSlot(const ComponentId index) const -> const EntityPtr&;
+    void updateGroupsComponentAddedOrRemoved(const EntityPtr& entity, ComponentId index, IComponent* component);
+    void updateGroupsComponentReplaced(const EntityPtr& entity, ComponentId index, IComponent* previousComponent, IComponent* newComponent);
+    bool hasGroupForIndex(ComponentId index, std::size_t i) const;
+    /// Removes a destroyed entity from the groups its group mask points to
+    void removeEntityFromGroups(const EntityPtr& entity);
+    void markDirty(const EntityPtr& entity, ComponentId index);
+    void flushDirtyComponents();
     void onEntityReleased(Entity* entity);
 
+    /// Declared first so entities outlive everything that references them
+    EntitySlab slab_;
     unsigned int creationIndex_; ///< Index that is used as uuid for Entities
-    std::unordered_set<EntityPtr> entities_;
+    unsigned int count_{ 0 }; ///< Number of enabled entities
     std::unordered_map<Matcher, Group::SharedPtr> groups_;
-    std::stack<Entity*> reusableEntities_;
+    /// Groups in creation order, the first ENTITAS_MAX_GROUPS of them
+    /// by their bit in the entities' group masks
+    std::vector<Group*> groupList_;
 
-    std::unordered_set<Entity*> retainedEntities_;
+    PooledSet<Entity*> retainedEntities_;
 
     ComponentPools componentPools_;
-    /// ComponentId to corresponding groups map
-    /// Used to quickly find groups when modifying components
-    std::map<ComponentId, std::vector<std::weak_ptr<Group>>> groupsForIndex_;
+    /// ComponentId to corresponding groups, indexed by ComponentId
+    /// Used to quickly find groups when modifying components.
+    /// Groups are owned by 'groups_'
+    std::vector<std::vector<Group*>> groupsForIndex_;
+    /// Events of updateGroupsComponentAddedOrRemoved(), nested calls from
+    /// the handlers append theirs after the ones of the outer call
+    std::vector<Group::GroupChanged*> groupEvents_;
+    std::unordered_map<std::string, std::shared_ptr<IEntityIndex>> entityIndices_;
+    std::vector<std::pair<std::vector<TriggerOnEvent>, std::weak_ptr<SharedCollector>>> sharedCollectors_;
+    /// Entities holding unique components, indexed by ComponentId
+    std::vector<EntityPtr> uniqueEntities_;
 
     Entities entitiesCache_;
-    // TODO cache other functions too
-    // so that we don't have to construct lambda everytime
-    std::function<void(Entity*)> onEntityReleasedCache_;
+
+    /// Entities with components modified in place, indexed by ComponentId
+    std::vector<Entities> dirtyEntities_;
+    Entities flushedDirtyEntities_;
+    /// Batched entities, swapped with the delivered ones on flush()
+    Entities createdEntities_;
+    Entities destroyedEntities_;
+    Entities deliveredCreatedEntities_;
+    Entities deliveredDestroyedEntities_;
+
+    /// Number of flushes, the frame of the group usage
+    unsigned long frame_{ 0 };
+
+    MemoryReport::Totals memoryPeak_;
+    std::size_t memoryPeakTotal_{ 0 };
 };
 
+template <typename T, typename... TArgs>
+auto Context::setUnique(TArgs&&... args) -> EntityPtr
+{
+    ComponentId index = ComponentTypeId::get<T>();
+    if (index >= uniqueEntities_.size()) {
+        uniqueEntities_.resize(index + 1);
+    }
+
+    auto& entity = uniqueEntities_[index];
+    if (entity && entity->isEnabled()) {
+        entity->replace<T>(std::forward<TArgs>(args)...);
+    } else {
+        entity = createEntity();
+        entity->add<T>(std::forward<TArgs>(args)...);
+    }
+
+    return entity;
+}
+
+template <typename T>
+auto Context::unique() const -> T*
+{
+    const EntityPtr& entity = getUniqueSlot(ComponentTypeId::get<T>());
+    if (!entity) {
+        throw std::runtime_error("Error, cannot get unique component from context, component has not been set");
+    }
+
+    return entity->get<T>();
+}
+
+template <typename T>
+bool Context::hasUnique() const
+{
+    return getUniqueSlot(ComponentTypeId::get<T>()) != nullptr;
+}
+
+template <typename T>
+void Context::removeUnique()
+{
+    ComponentId index = ComponentTypeId::get<T>();
+    if (index < uniqueEntities_.size() && uniqueEntities_[index]) {
+        auto entity = std::move(uniqueEntities_[index]);
+        if (entity->isEnabled()) {
+            destroyEntity(entity);
+        }
+    }
+}
+
+template <typename T>
+auto Context::getUniqueEntity() const -> EntityPtr
+{
+    return getUniqueSlot(ComponentTypeId::get<T>());
+}
+
+template <typename T>
+auto Context::getEntityIndex(const std::string& name) const -> std::shared_ptr<T>
+{
+    return std::static_pointer_cast<T>(getEntityIndex(name));
+}
+
 template <typename T>
 auto Context::createSystem() -> std::shared_ptr<ISystem>
 {
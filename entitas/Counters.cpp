@@ -0,0 +1,113 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#include "Counters.hpp"
+
+#ifdef ENTITAS_COUNTERS
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace entitas {
+namespace {
+    using Slots = std::array<std::uint64_t, detail::CounterBlock::kSize>;
+
+    /// The blocks of the running threads
+    struct Registry {
+        std::mutex mutex;
+        std::vector<detail::CounterBlock*> blocks;
+        /// Counts of the threads that exited
+        Slots retired{};
+        /// Counts at the last reset
+        Slots baseline{};
+
+        /// Called with 'mutex' held
+        auto sum() const -> Slots
+        {
+            auto slots = retired;
+            for (auto block : blocks) {
+                for (std::size_t i = 0; i < slots.size(); ++i) {
+                    slots[i] += block->load(i);
+                }
+            }
+            return slots;
+        }
+    };
+
+    auto getRegistry() -> Registry&
+    {
+        // Never destroyed, threads might exit after static destruction
+        static auto registry = new Registry();
+        return *registry;
+    }
+}
+
+namespace detail {
+    CounterBlock::CounterBlock()
+    {
+        for (auto& slot : slots_) {
+            slot.store(0, std::memory_order_relaxed);
+        }
+
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.blocks.push_back(this);
+    }
+
+    CounterBlock::~CounterBlock()
+    {
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (std::size_t i = 0; i < kSize; ++i) {
+            registry.retired[i] += load(i);
+        }
+        registry.blocks.erase(std::find(registry.blocks.begin(), registry.blocks.end(), this));
+    }
+} // namespace detail
+
+auto readCounters() -> Counters
+{
+    auto& registry = getRegistry();
+    Slots slots;
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        slots = registry.sum();
+        for (std::size_t i = 0; i < slots.size(); ++i) {
+            slots[i] -= registry.baseline[i];
+        }
+    }
+
+    Counters counters;
+    std::copy(slots.begin(), slots.begin() + Counters::kCount, counters.values.begin());
+    for (std::size_t counter = 0; counter < Counters::kComponentCount; ++counter) {
+        auto begin = slots.begin() + Counters::kCount + counter * ENTITAS_MAX_COMPONENTS;
+        std::copy(begin, begin + ENTITAS_MAX_COMPONENTS, counters.components[counter].begin());
+    }
+
+    return counters;
+}
+
+void resetCounters()
+{
+    auto& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.baseline = registry.sum();
+}
+} // namespace entitas
+
+#else
+
+namespace entitas {
+auto readCounters() -> Counters
+{
+    return Counters{};
+}
+
+void resetCounters()
+{
+}
+} // namespace entitas
+
+#endif
@@ -0,0 +1,134 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#pragma once
+
+// Counts of what the engine does on its hot paths. They are only kept
+// when ENTITAS_COUNTERS is defined, otherwise the macros at the end
+// expand to nothing and the counts stay at zero.
+
+#include "ComponentTypeId.hpp"
+#include <array>
+#include <cstdint>
+
+#ifdef ENTITAS_COUNTERS
+#include <atomic>
+#endif
+
+namespace entitas {
+
+enum class Counter : std::size_t {
+    EntitiesCreated,
+    EntitiesDestroyed,
+    MatcherEvaluations,
+    GroupEntitiesAdded,
+    GroupEntitiesRemoved,
+    /// One per handler called
+    DelegateInvocations,
+    CollectorInserts,
+    /// Components reused from the ComponentPools
+    ComponentPoolHits,
+    /// Components allocated because their pool was empty
+    ComponentPoolMisses,
+    Count
+};
+
+/// Counted per ComponentId
+enum class ComponentCounter : std::size_t {
+    Added,
+    Removed,
+    Replaced,
+    Count
+};
+
+/// Counts since the last reset, of all threads
+struct Counters {
+    static const std::size_t kCount = static_cast<std::size_t>(Counter::Count);
+    static const std::size_t kComponentCount = static_cast<std::size_t>(ComponentCounter::Count);
+
+    auto get(Counter counter) const -> std::uint64_t
+    {
+        return values[static_cast<std::size_t>(counter)];
+    }
+
+    auto get(ComponentCounter counter, ComponentId index) const -> std::uint64_t
+    {
+        return components[static_cast<std::size_t>(counter)][index];
+    }
+
+    /// Of all component types
+    auto getTotal(ComponentCounter counter) const -> std::uint64_t
+    {
+        std::uint64_t total = 0;
+        for (auto value : components[static_cast<std::size_t>(counter)]) {
+            total += value;
+        }
+        return total;
+    }
+
+    std::array<std::uint64_t, kCount> values{};
+    std::array<std::array<std::uint64_t, ENTITAS_MAX_COMPONENTS>, kComponentCount> components{};
+};
+
+/// Sums the counts of all threads, including the ones that exited
+auto readCounters() -> Counters;
+/// Starts counting from zero again. Threads keep counting meanwhile,
+/// what they count afterwards shows in the next read.
+void resetCounters();
+
+#ifdef ENTITAS_COUNTERS
+namespace detail {
+    /// Counts of one thread. Only that thread writes them, so increments
+    /// are a plain load and store; relaxed atomics let readCounters() read
+    /// them from another thread.
+    class CounterBlock {
+    public:
+        static const std::size_t kSize = Counters::kCount + Counters::kComponentCount * ENTITAS_MAX_COMPONENTS;
+
+        CounterBlock();
+        ~CounterBlock();
+
+        CounterBlock(const CounterBlock&) = delete;
+        CounterBlock& operator=(const CounterBlock&) = delete;
+
+        void add(Counter counter)
+        {
+            increment(static_cast<std::size_t>(counter));
+        }
+
+        void add(ComponentCounter counter, ComponentId index)
+        {
+            increment(Counters::kCount + static_cast<std::size_t>(counter) * ENTITAS_MAX_COMPONENTS + index);
+        }
+
+        auto load(std::size_t slot) const -> std::uint64_t
+        {
+            return slots_[slot].load(std::memory_order_relaxed);
+        }
+
+    private:
+        void increment(std::size_t slot)
+        {
+            slots_[slot].store(slots_[slot].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        std::array<std::atomic<std::uint64_t>, kSize> slots_;
+    };
+
+    inline auto getCounterBlock() -> CounterBlock&
+    {
+        thread_local CounterBlock block;
+        return block;
+    }
+} // namespace detail
+#endif
+} // namespace entitas
+
+#ifdef ENTITAS_COUNTERS
+#define ENTITAS_COUNT(counter) ::entitas::detail::getCounterBlock().add(::entitas::Counter::counter)
+#define ENTITAS_COUNT_COMPONENT(counter, index) ::entitas::detail::getCounterBlock().add(::entitas::ComponentCounter::counter, index)
+#else
+#define ENTITAS_COUNT(counter)
+#define ENTITAS_COUNT_COMPONENT(counter, index)
+#endif
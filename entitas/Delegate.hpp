@@ -8,146 +8,519 @@
 
 #pragma once
 
-#include <list>
+#include <atomic>
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <vector>
 
-#include "Functional.hpp"
+#include "Counters.hpp"
+#include "InlineFunction.hpp"
 
 namespace entitas {
-template <typename>
+
+/// Threading policies for Delegate.
+/// SingleThreaded never locks. Handlers may connect and disconnect
+/// (themselves or others) while the delegate is being invoked.
+struct SingleThreaded {
+};
+/// MultiThreaded can be invoked from any number of threads while others
+/// connect or disconnect. Invocation never locks, it walks an immutable
+/// copy of the handlers; connecting and disconnecting copy it.
+struct MultiThreaded {
+};
+
+template <typename, typename TPolicy = SingleThreaded>
 class Delegate;
 
+template <typename TSignature>
+using ConcurrentDelegate = Delegate<TSignature, MultiThreaded>;
+
+/// Returned by Delegate::connect() and used to disconnect in O(1)
+using DelegateHandle = std::uint64_t;
+
 /* -------------------------------------------------------------------------- */
 
 namespace detail {
 
+    template <typename TFunction>
+    struct DelegateSlot {
+        // Use an id alongside function so that we can identify them for later removal
+        std::size_t id;
+        TFunction function;
+        DelegateHandle handle;
+    };
+
+    template <typename TPolicy, typename TFunction>
+    class DelegateStorage;
+
+    /* ---------------------------------------------------------------------- */
+
+    template <typename TFunction>
+    class DelegateStorage<SingleThreaded, TFunction> {
+        using Slot = DelegateSlot<TFunction>;
+
+        /// Where the slot of a handle currently is.
+        /// Handles are index + generation so stale handles are ignored.
+        struct HandleEntry {
+            std::uint32_t slot;
+            std::uint32_t generation;
+        };
+
+        static const std::uint32_t kPending = 0x80000000u;
+        /// Handle of a disconnected slot. Its function might be running, so
+        /// it is only destroyed by settle().
+        static const DelegateHandle kDisconnected = ~DelegateHandle(0);
+
+        /// Adds and removals during invocation are applied once the
+        /// outermost invocation returns, so the slots never move under a
+        /// running handler.
+        struct InvocationGuard {
+            DelegateStorage& storage;
+            InvocationGuard(DelegateStorage& s)
+                : storage(s)
+            {
+                ++storage.invoking_;
+            }
+            ~InvocationGuard()
+            {
+                if (--storage.invoking_ == 0 && storage.dirty_) {
+                    storage.settle();
+                }
+            }
+        };
+
+    public:
+        auto connect(std::size_t id, TFunction&& function) -> DelegateHandle
+        {
+            std::uint32_t handleIndex;
+            if (freeHandles_.empty()) {
+                handleIndex = static_cast<std::uint32_t>(handles_.size());
+                handles_.push_back(HandleEntry{ 0, 0 });
+            } else {
+                handleIndex = freeHandles_.back();
+                freeHandles_.pop_back();
+            }
+
+            auto& entry = handles_[handleIndex];
+            auto handle = (static_cast<DelegateHandle>(entry.generation) << 32) | handleIndex;
+
+            if (invoking_ > 0) {
+                entry.slot = kPending | static_cast<std::uint32_t>(pending_.size());
+                pending_.push_back(Slot{ id, std::move(function), handle });
+                dirty_ = true;
+            } else {
+                entry.slot = static_cast<std::uint32_t>(slots_.size());
+                slots_.push_back(Slot{ id, std::move(function), handle });
+            }
+
+            return handle;
+        }
+
+        void disconnect(DelegateHandle handle)
+        {
+            auto handleIndex = static_cast<std::uint32_t>(handle);
+            if (handleIndex >= handles_.size() || handles_[handleIndex].generation != static_cast<std::uint32_t>(handle >> 32)) {
+                return;
+            }
+
+            auto slot = handles_[handleIndex].slot;
+            releaseHandle(handleIndex);
+
+            if (slot & kPending) {
+                pending_[slot & ~kPending].handle = kDisconnected;
+            } else if (invoking_ > 0) {
+                slots_[slot].handle = kDisconnected;
+                dirty_ = true;
+            } else {
+                removeSlot(slot);
+            }
+        }
+
+        void disconnectId(std::size_t id)
+        {
+            for (std::size_t i = slots_.size(); i-- > 0;) {
+                if (slots_[i].id == id && slots_[i].handle != kDisconnected) {
+                    disconnect(slots_[i].handle);
+                }
+            }
+            for (auto& slot : pending_) {
+                if (slot.id == id && slot.handle != kDisconnected) {
+                    disconnect(slot.handle);
+                }
+            }
+        }
+
+        void clear()
+        {
+            for (std::size_t i = slots_.size(); i-- > 0;) {
+                if (slots_[i].handle != kDisconnected) {
+                    disconnect(slots_[i].handle);
+                }
+            }
+            for (auto& slot : pending_) {
+                if (slot.handle != kDisconnected) {
+                    disconnect(slot.handle);
+                }
+            }
+        }
+
+        template <typename F>
+        void forEach(F fn)
+        {
+            if (slots_.empty()) {
+                return;
+            }
+
+            InvocationGuard guard(*this);
+            for (std::size_t i = 0, count = slots_.size(); i < count; ++i) {
+                const auto& slot = slots_[i];
+                if (slot.handle != kDisconnected) {
+                    fn(slot.function);
+                }
+            }
+        }
+
+        bool empty() const
+        {
+            return slots_.size() + pending_.size() == freeSlotsCount();
+        }
+
+        auto size() const -> std::size_t
+        {
+            return slots_.size() + pending_.size() - freeSlotsCount();
+        }
+
+        auto getMemoryBytes() const -> std::size_t
+        {
+            return (slots_.capacity() + pending_.capacity()) * sizeof(Slot)
+                + handles_.capacity() * sizeof(HandleEntry)
+                + freeHandles_.capacity() * sizeof(std::uint32_t);
+        }
+
+    private:
+        auto freeSlotsCount() const -> std::size_t
+        {
+            // Only tombstones left behind by an invocation are not yet removed
+            if (!dirty_) {
+                return 0;
+            }
+
+            std::size_t count = 0;
+            for (const auto& slot : slots_) {
+                count += slot.handle == kDisconnected ? 1 : 0;
+            }
+            for (const auto& slot : pending_) {
+                count += slot.handle == kDisconnected ? 1 : 0;
+            }
+            return count;
+        }
+
+        void releaseHandle(std::uint32_t handleIndex)
+        {
+            ++handles_[handleIndex].generation;
+            freeHandles_.push_back(handleIndex);
+        }
+
+        /// Swap with the last slot and pop, fixing the moved slot's handle
+        void removeSlot(std::uint32_t slot)
+        {
+            if (slot + 1 != slots_.size()) {
+                slots_[slot] = std::move(slots_.back());
+                handles_[static_cast<std::uint32_t>(slots_[slot].handle)].slot = slot;
+            }
+            slots_.pop_back();
+        }
+
+        void settle()
+        {
+            dirty_ = false;
+
+            for (std::size_t i = slots_.size(); i-- > 0;) {
+                if (slots_[i].handle == kDisconnected) {
+                    removeSlot(static_cast<std::uint32_t>(i));
+                }
+            }
+
+            for (auto& slot : pending_) {
+                if (slot.handle != kDisconnected) {
+                    handles_[static_cast<std::uint32_t>(slot.handle)].slot = static_cast<std::uint32_t>(slots_.size());
+                    slots_.push_back(std::move(slot));
+                }
+            }
+            pending_.clear();
+        }
+
+        std::vector<Slot> slots_;
+        std::vector<Slot> pending_;
+        std::vector<HandleEntry> handles_;
+        std::vector<std::uint32_t> freeHandles_;
+        unsigned int invoking_{ 0 };
+        bool dirty_{ false };
+    };
+
+    /* ---------------------------------------------------------------------- */
+
+    template <typename TFunction>
+    class DelegateStorage<MultiThreaded, TFunction> {
+        using Slot = DelegateSlot<TFunction>;
+        using Slots = std::vector<Slot>;
+
+        struct ReadGuard {
+            std::atomic<unsigned int>& readers;
+            ReadGuard(std::atomic<unsigned int>& r)
+                : readers(r)
+            {
+                readers.fetch_add(1);
+            }
+            ~ReadGuard() { readers.fetch_sub(1); }
+        };
+
+    public:
+        DelegateStorage() = default;
+
+        ~DelegateStorage()
+        {
+            delete current_.load();
+            for (auto slots : retired_) {
+                delete slots;
+            }
+        }
+
+        auto connect(std::size_t id, TFunction&& function) -> DelegateHandle
+        {
+            std::lock_guard<std::mutex> lock(writeMutex_);
+            auto handle = ++lastHandle_;
+            auto next = copyCurrent();
+            next->push_back(Slot{ id, std::move(function), handle });
+            publish(next);
+            return handle;
+        }
+
+        void disconnect(DelegateHandle handle)
+        {
+            removeIf([handle](const Slot& slot) { return slot.handle == handle; });
+        }
+
+        void disconnectId(std::size_t id)
+        {
+            removeIf([id](const Slot& slot) { return slot.id == id; });
+        }
+
+        void clear()
+        {
+            removeIf([](const Slot&) { return true; });
+        }
+
+        template <typename F>
+        void forEach(F fn)
+        {
+            // Announce the reader before loading, so a writer that sees no
+            // readers knows nobody can still hold a retired copy
+            ReadGuard guard(readers_);
+            auto slots = current_.load();
+            if (slots == nullptr) {
+                return;
+            }
+
+            for (const auto& slot : *slots) {
+                fn(slot.function);
+            }
+        }
+
+        bool empty() const
+        {
+            return size() == 0;
+        }
+
+        auto size() const -> std::size_t
+        {
+            ReadGuard guard(readers_);
+            auto slots = current_.load();
+            return slots ? slots->size() : 0;
+        }
+
+        /// Retired copies not included, they go away with the last reader
+        auto getMemoryBytes() const -> std::size_t
+        {
+            ReadGuard guard(readers_);
+            auto slots = current_.load();
+            return slots ? sizeof(Slots) + slots->capacity() * sizeof(Slot) : 0;
+        }
+
+    private:
+        auto copyCurrent() const -> Slots*
+        {
+            auto slots = current_.load();
+            return slots ? new Slots(*slots) : new Slots();
+        }
+
+        template <typename F>
+        void removeIf(F predicate)
+        {
+            std::lock_guard<std::mutex> lock(writeMutex_);
+            auto slots = current_.load();
+            if (slots == nullptr) {
+                return;
+            }
+
+            auto next = new Slots();
+            next->reserve(slots->size());
+            for (const auto& slot : *slots) {
+                if (!predicate(slot)) {
+                    next->push_back(slot);
+                }
+            }
+
+            if (next->size() == slots->size()) {
+                delete next;
+                return;
+            }
+            publish(next);
+        }
+
+        /// Called with 'writeMutex_' held
+        void publish(Slots* next)
+        {
+            if (auto previous = current_.exchange(next)) {
+                retired_.push_back(previous);
+            }
+
+            // Readers that started after the exchange see 'next', so once
+            // there are no readers at all the retired copies are unused
+            if (readers_.load() == 0) {
+                for (auto slots : retired_) {
+                    delete slots;
+                }
+                retired_.clear();
+            }
+        }
+
+        std::atomic<Slots*> current_{ nullptr };
+        mutable std::atomic<unsigned int> readers_{ 0 };
+        std::mutex writeMutex_;
+        std::vector<Slots*> retired_;
+        DelegateHandle lastHandle_{ 0 };
+    };
+
+    /* ---------------------------------------------------------------------- */
+
     template <typename TReturnType, typename... TArgs>
     struct Invoker {
         using ReturnType = std::vector<TReturnType>;
 
     public:
-        static ReturnType invoke(Delegate<TReturnType(TArgs...)>& delegate,
-            TArgs... params)
+        template <typename TStorage>
+        static ReturnType invoke(TStorage& storage, TArgs... params)
         {
-            std::lock_guard<std::mutex> lock(delegate.mutex_);
             ReturnType returnValues;
-
-            for (const auto& functionPtr : delegate.functionList_) {
-                returnValues.push_back((*functionPtr)(params...));
-            }
-
+            storage.forEach([&](const InlineFunction<TReturnType(TArgs...)>& function) {
+                ENTITAS_COUNT(DelegateInvocations);
+                returnValues.push_back(function(params...));
+            });
             return returnValues;
         }
     };
 
-    /* -------------------------------------------------------------------------- */
+    /* ---------------------------------------------------------------------- */
 
     template <typename... TArgs>
     struct Invoker<void, TArgs...> {
         using ReturnType = void;
 
     public:
-        static void invoke(Delegate<void(TArgs...)>& delegate, TArgs... params)
+        template <typename TStorage>
+        static void invoke(TStorage& storage, TArgs... params)
         {
-            std::lock_guard<std::mutex> lock(delegate.mutex_);
-            if (delegate.functionList_.empty())
-                return;
-            for_each(delegate.functionList_,
-                [&](auto& fpair) {
-                    auto& f = fpair.second;
-                    f(params...);
-                });
+            storage.forEach([&](const InlineFunction<void(TArgs...)>& function) {
+                ENTITAS_COUNT(DelegateInvocations);
+                function(params...);
+            });
         }
     };
 } // namespace detail
 
 /* -------------------------------------------------------------------------- */
 
-template <typename TReturnType, typename... TArgs>
-class Delegate<TReturnType(TArgs...)> {
+template <typename TReturnType, typename... TArgs, typename TPolicy>
+class Delegate<TReturnType(TArgs...), TPolicy> {
     using Invoker = detail::Invoker<TReturnType, TArgs...>;
-    using FunctionType = std::function<TReturnType(TArgs...)>;
+    using FunctionType = InlineFunction<TReturnType(TArgs...)>;
     // Use an id alongside function so that we can identify them for later removal
     using FunctionPair = std::pair<size_t, FunctionType>;
-    // using FunctionPointer = std::shared_ptr<FunctionType>;
-    using FunctionPointer = FunctionType;
-    friend Invoker;
+
+    /// Id of handlers added through connect(), never matched by remove()
+    static const std::size_t kNoId = std::numeric_limits<std::size_t>::max();
 
 public:
-public:
+    using Handle = DelegateHandle;
+
     Delegate() {}
     ~Delegate() {}
 
     Delegate(const Delegate&) = delete;
     const Delegate& operator=(const Delegate&) = delete;
 
-    // Delegate& Connect(const FunctionType& function)
-    Delegate& Connect(FunctionPair&& function)
+    /// Adds a handler, the returned handle removes it in O(1)
+    Handle connect(FunctionType function)
+    {
+        return storage_.connect(kNoId, std::move(function));
+    }
+
+    Delegate& disconnect(Handle handle)
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        functionList_.emplace_back(function);
+        storage_.disconnect(handle);
         return *this;
     }
 
-    // Delegate& remove(const FunctionType& function)
-    Delegate& remove(const FunctionPair function)
+    Delegate& Connect(FunctionPair&& function)
     {
-        using namespace std;
-        lock_guard<mutex> lock(mutex_);
-        if (!functionList_.empty())
-            functionList_.erase(remove_if(begin(functionList_), end(functionList_),
-                                    bind(areEqual1, function.first, placeholders::_1)),
-                end(functionList_));
+        storage_.connect(function.first, std::move(function.second));
+        return *this;
+    }
 
+    /// Removes all handlers added with the same id
+    Delegate& remove(const FunctionPair& function)
+    {
+        if (function.first != kNoId) {
+            storage_.disconnectId(function.first);
+        }
         return *this;
     }
 
     inline typename Invoker::ReturnType invoke(TArgs... args)
     {
-        return Invoker::invoke(*this, args...);
+        return Invoker::invoke(storage_, args...);
     }
 
     Delegate& clear()
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        functionList_.clear();
+        storage_.clear();
         return *this;
     }
 
-    // inline Delegate& operator+=(const FunctionType& function)
+    bool empty() const { return storage_.empty(); }
+    auto size() const -> std::size_t { return storage_.size(); }
+    /// Heap bytes used to store the handlers
+    auto getMemoryBytes() const -> std::size_t { return storage_.getMemoryBytes(); }
+
     inline Delegate& operator+=(FunctionPair&& function)
     {
         return Connect(std::move(function));
     }
 
-    // inline Delegate& operator-=(const FunctionType& function)
-    inline Delegate& operator-=(const FunctionPair function)
+    inline Delegate& operator-=(const FunctionPair& function)
     {
         return remove(function);
     }
 
     inline typename Invoker::ReturnType operator()(TArgs... args)
     {
-        return Invoker::invoke(*this, args...);
-    }
-    static inline bool areEqual1(size_t ind1, const FunctionPair& f2)
-    {
-        return ind1 == f2.first;
-    }
-    static inline bool areEqual(const FunctionPair& f1, const FunctionPair& f2)
-    {
-        return f1.first == f2.first;
-    }
-
-    static inline constexpr size_t hash(const FunctionType& function)
-    {
-        return function.target_type().hash_code();
+        return Invoker::invoke(storage_, args...);
     }
 
 private:
-    std::mutex mutex_;
-    std::vector<FunctionPair> functionList_;
+    detail::DelegateStorage<TPolicy, FunctionType> storage_;
 };
 }
@@ -3,17 +3,14 @@
 // License: MIT License
 // MIT License web page: https://opensource.org/licenses/MIT
 #include "Entity.hpp"
+#include "Context.hpp"
 #include <algorithm>
 
 namespace entitas {
-//Entity::Entity(ComponentPools* componentPools)
-//{
-//	componentPools_ = componentPools;
-//}
 
-auto Entity::addComponent(const ComponentId index, IComponent* component) -> EntityPtr
+auto Entity::addComponent(const ComponentId index, IComponent* component) -> const EntityPtr&
 {
-    if (!enabled_) {
+    if (!record_->enabled) {
         throw std::runtime_error("Error, cannot add component to entity, entity has already been destroyed.");
     }
 
@@ -21,16 +18,21 @@ auto Entity::addComponent(const ComponentId index, IComponent* component) -> Ent
         throw std::runtime_error("Error, cannot add component to entity, component already exists");
     }
 
-    components_[index] = component;
+    record_->signature.set(index);
+    ENTITAS_COUNT_COMPONENT(Added, index);
+    if (!ComponentTypeId::isTag(index)) {
+        components_[index] = component;
+    }
 
-    onComponentAdded(instance_.lock(), index, component);
+    context_->updateGroupsComponentAddedOrRemoved(instance_, index, component);
+    onComponentAdded(instance_, index, component);
 
-    return instance_.lock();
+    return instance_;
 }
 
-auto Entity::removeComponent(const ComponentId index) -> EntityPtr
+auto Entity::removeComponent(const ComponentId index) -> const EntityPtr&
 {
-    if (!enabled_) {
+    if (!record_->enabled) {
         throw std::runtime_error("Error, cannot remove component to entity, entity has already been destroyed.");
     }
 
@@ -40,12 +42,12 @@ auto Entity::removeComponent(const ComponentId index) -> EntityPtr
 
     replace(index, nullptr);
 
-    return instance_.lock();
+    return instance_;
 }
 
-auto Entity::replaceComponent(const ComponentId index, IComponent* component) -> EntityPtr
+auto Entity::replaceComponent(const ComponentId index, IComponent* component) -> const EntityPtr&
 {
-    if (!enabled_) {
+    if (!record_->enabled) {
         throw std::runtime_error("Error, cannot replace component to entity, entity has already been destroyed.");
     }
 
@@ -55,7 +57,7 @@ auto Entity::replaceComponent(const ComponentId index, IComponent* component) ->
         addComponent(index, component);
     }
 
-    return instance_.lock();
+    return instance_;
 }
 
 auto Entity::getComponent(const ComponentId index) const -> IComponent*
@@ -64,12 +66,16 @@ auto Entity::getComponent(const ComponentId index) const -> IComponent*
         throw std::runtime_error("Error, cannot get component from entity, component does not exists");
     }
 
+    if (auto tag = ComponentTypeId::getTagInstance(index)) {
+        return tag;
+    }
+
     return components_.at(index);
 }
 
 bool Entity::hasComponent(const ComponentId index) const
 {
-    return (components_.find(index) != components_.end());
+    return record_->signature.test(index);
 }
 
 bool Entity::hasComponents(const std::vector<ComponentId>& indices) const
@@ -85,22 +91,24 @@ bool Entity::hasAnyComponent(const std::vector<ComponentId>& indices) const
 
 auto Entity::getComponentsCount() const -> unsigned int
 {
-    return static_cast<unsigned>(components_.size());
+    return static_cast<unsigned>(record_->signature.count());
+}
+
+auto Entity::getSignature() const -> const ComponentMask&
+{
+    return record_->signature;
 }
 
 void Entity::removeAllComponents()
 {
-    std::vector<ComponentId> componentsIds;
-    //for (const auto& pair : components_) {
-    //    componentsIdTemp.push_back(pair.first);
-    //}
-    using namespace std;
-    transform(begin(components_), end(components_), back_inserter(componentsIds), [](auto& p) { return p.first; });
-
-    while (!components_.empty()) {
-        // Replacing with nullptr removes it
-        replace(componentsIds.back(), nullptr);
-        componentsIds.pop_back();
+    // The components at the time of the call, last one first
+    auto signature = record_->signature;
+    for (auto i = static_cast<ComponentId>(ComponentTypeId::count()); i-- > 0;) {
+        // A handler might have removed it already
+        if (signature.test(i) && hasComponent(i)) {
+            // Replacing with nullptr removes it
+            replace(i, nullptr);
+        }
     }
 }
 
@@ -109,9 +117,19 @@ auto Entity::getUuid() const -> unsigned int
     return uuid_;
 }
 
-bool Entity::isEnabled()
+auto Entity::getSlot() const -> std::uint32_t
+{
+    return slot_;
+}
+
+auto Entity::getGeneration() const -> std::uint32_t
 {
-    return enabled_;
+    return record_->generation;
+}
+
+bool Entity::isEnabled() const
+{
+    return record_->enabled;
 }
 
 bool Entity::operator==(const EntityPtr& right) const
@@ -124,41 +142,81 @@ bool Entity::operator==(const Entity right) const
     return this->getUuid() == right.getUuid();
 }
 
-void Entity::setInstance(EntityPtr instance)
+void Entity::setInstance(const EntityPtr& instance)
 {
     instance_ = instance;
 }
 
 void Entity::destroy()
 {
+    // Like in Entitas the entity gets disabled before its components are
+    // removed, it leaves exactly the groups it is in and its components go
+    // without the groups matching it again
+    record_->enabled = false;
+    context_->removeEntityFromGroups(instance_);
     removeAllComponents();
     onComponentAdded.clear();
     onComponentReplaced.clear();
     onComponentRemoved.clear();
-    enabled_ = false;
+    dirty_.reset();
+    ++record_->generation;
+    instance_.reset();
+}
+
+void Entity::markDirty(const ComponentId index)
+{
+    if (!record_->enabled) {
+        throw std::runtime_error("Error, cannot modify component of entity, entity has already been destroyed.");
+    }
+
+    dirty_.set(index);
+    context_->markDirty(instance_, index);
 }
 
 auto Entity::getComponentPool(const ComponentId index) const -> ComponentPool&
 {
-    return (componentPools_[index]);
+    return (context_->componentPools_[index]);
 }
 
 void Entity::replace(const ComponentId index, IComponent* replacement)
 {
     auto previousComponent = getComponent(index);
+    // Groups already let go of a destroyed entity
+    auto notifyContext = record_->enabled;
 
     if (previousComponent == replacement) {
-        onComponentReplaced(instance_.lock(), index, previousComponent, replacement);
+        ENTITAS_COUNT_COMPONENT(Replaced, index);
+        if (notifyContext) {
+            context_->updateGroupsComponentReplaced(instance_, index, previousComponent, replacement);
+        }
+        onComponentReplaced(instance_, index, previousComponent, replacement);
+    } else if (ComponentTypeId::isTag(index)) {
+        // A tag can only be replaced by itself, so this is a removal
+        record_->signature.reset(index);
+        ENTITAS_COUNT_COMPONENT(Removed, index);
+        if (notifyContext) {
+            context_->updateGroupsComponentAddedOrRemoved(instance_, index, previousComponent);
+        }
+        onComponentRemoved(instance_, index, previousComponent);
     } else {
         // Save 'replaced' component to the pool for later reuse
         getComponentPool(index).push(previousComponent);
 
         if (replacement == nullptr) {
+            record_->signature.reset(index);
             components_.erase(index);
-            onComponentRemoved(instance_.lock(), index, previousComponent);
+            ENTITAS_COUNT_COMPONENT(Removed, index);
+            if (notifyContext) {
+                context_->updateGroupsComponentAddedOrRemoved(instance_, index, previousComponent);
+            }
+            onComponentRemoved(instance_, index, previousComponent);
         } else {
             components_[index] = replacement;
-            onComponentReplaced(instance_.lock(), index, previousComponent, replacement);
+            ENTITAS_COUNT_COMPONENT(Replaced, index);
+            if (notifyContext) {
+                context_->updateGroupsComponentReplaced(instance_, index, previousComponent, replacement);
+            }
+            onComponentReplaced(instance_, index, previousComponent, replacement);
         }
     }
 }
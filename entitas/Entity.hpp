@@ -6,19 +6,49 @@
 #pragma once
 
 #include "ComponentTypeId.hpp"
+#include "Counters.hpp"
 #include "Delegate.hpp"
+#include "PoolAllocator.hpp"
+#include <bitset>
+#include <cstdint>
 #include <map>
 #include <stack>
+#include <vector>
 
 #include <fmt/format.h>
 
 namespace entitas {
+class Context;
 class Entity;
 using EntityPtr = std::shared_ptr<Entity>;
 using EntityPtrWeak = std::weak_ptr<Entity>;
-using ComponentPool = std::stack<IComponent*>;
+/// Vector backed, so it keeps its storage when it runs empty
+using ComponentPool = std::stack<IComponent*, std::vector<IComponent*>>;
 using ComponentPools = std::map<ComponentId, ComponentPool>;
 
+/// Groups per context with a bit in the entities' group masks. Groups
+/// created past that look entities up in their own set instead.
+#ifndef ENTITAS_MAX_GROUPS
+#define ENTITAS_MAX_GROUPS 64
+#endif
+
+/// One bit per group of a context, set if an entity is in that group
+using GroupMask = std::bitset<ENTITAS_MAX_GROUPS>;
+
+/* -------------------------------------------------------------------------- */
+
+/// Per-entity metadata, stored contiguously by the context's EntitySlab
+/// so scans over entities don't have to touch the Entity objects.
+struct EntityRecord {
+    ComponentMask signature;
+    /// Maintained by the groups themselves
+    GroupMask groups;
+    Entity* entity{ nullptr };
+    /// Incremented every time the entity gets destroyed
+    std::uint32_t generation{ 0 };
+    bool enabled{ false };
+};
+
 /* -------------------------------------------------------------------------- */
 
 /// Use context.CreateEntity() to create a new entity and
@@ -26,31 +56,38 @@ using ComponentPools = std::map<ComponentId, ComponentPool>;
 /// You can add, replace and remove IComponent to an entity.
 class Entity {
     friend class Context;
+    friend class Group;
 
 public:
-    Entity(ComponentPools& componentPools)
-        : componentPools_{ componentPools } {};
-    
-
-
-    ~Entity()
-    {
-        fmt::print("~Entity() id: {}", getUuid());
-    }
+    Entity(Context* context, EntityRecord* record, std::uint32_t slot)
+        : context_{ context }
+        , record_{ record }
+        , slot_{ slot } {};
 
     template <typename T, typename... TArgs>
-    inline auto add(TArgs&&... args) -> EntityPtr;
+    inline auto add(TArgs&&... args) -> const EntityPtr&;
     template <typename T>
-    inline auto remove() -> EntityPtr;
+    inline auto remove() -> const EntityPtr&;
     template <typename T, typename... TArgs>
-    inline auto replace(TArgs&&... args) -> EntityPtr;
+    inline auto replace(TArgs&&... args) -> const EntityPtr&;
     template <typename T>
-    inline auto refresh() -> EntityPtr;
+    inline auto refresh() -> const EntityPtr&;
 
     template <typename T>
     inline auto get() const -> T*;
+    /// Returns the component for in-place changes. The change is reported
+    /// as a replace once per entity and component by context.flush(),
+    /// no matter how many times it is modified until then. The previous
+    /// and the new component of that replace are the same object, so
+    /// handlers that need the previous value must keep it themselves,
+    /// like the entity indices keep their keys.
+    template <typename T>
+    inline auto modify() -> T&;
+    /// Reports a replace right away, before the caller changes the returned
+    /// component, so handlers of the replace like the entity indices see
+    /// the old values. Use modify() and context.flush() once per frame.
     template <typename T>
-    inline auto use() -> T*;
+    [[deprecated("use modify() and report the changes with context.flush()")]] inline auto use() -> T*;
     template <typename T>
     inline bool has() const;
 
@@ -59,15 +96,23 @@ public:
     // Whether Entity has any of the components
     bool hasAnyComponent(const std::vector<ComponentId>& indices) const;
     auto getComponentsCount() const -> unsigned int;
+    /// One bit per component the entity has, tags included
+    auto getSignature() const -> const ComponentMask&;
     void removeAllComponents();
     auto getUuid() const -> unsigned int;
-    bool isEnabled();
+    /// Slot of the entity in the context's EntitySlab, reused after release
+    auto getSlot() const -> std::uint32_t;
+    /// Tells apart the entities that used the same slot over time
+    auto getGeneration() const -> std::uint32_t;
+    bool isEnabled() const;
 
     bool operator==(const EntityPtr& right) const;
     bool operator==(const Entity right) const;
 
-    using EntityChanged = Delegate<void(EntityPtr entity, ComponentId index, IComponent* component)>;
-    using ComponentReplaced = Delegate<void(EntityPtr entity, ComponentId index, IComponent* previousComponent, IComponent* newComponent)>;
+    // Events pass the entity by reference, handlers that need to keep it
+    // around must copy the pointer themselves
+    using EntityChanged = Delegate<void(const EntityPtr& entity, ComponentId index, IComponent* component)>;
+    using ComponentReplaced = Delegate<void(const EntityPtr& entity, ComponentId index, IComponent* previousComponent, IComponent* newComponent)>;
     using EntityReleased = Delegate<void(Entity* entity)>;
 
     EntityChanged onComponentAdded;
@@ -79,13 +124,13 @@ public:
     EntityReleased onReleased;
 
 protected:
-    void setInstance(EntityPtr instance);
+    void setInstance(const EntityPtr& instance);
     /// Adds a component at the specified index.
     /// You can only have one component at an index.
     /// Each component type must have its own constant index.
-    auto addComponent(const ComponentId index, IComponent* component) -> EntityPtr;
-    auto removeComponent(const ComponentId index) -> EntityPtr;
-    auto replaceComponent(const ComponentId index, IComponent* component) -> EntityPtr;
+    auto addComponent(const ComponentId index, IComponent* component) -> const EntityPtr&;
+    auto removeComponent(const ComponentId index) -> const EntityPtr&;
+    auto replaceComponent(const ComponentId index, IComponent* component) -> const EntityPtr&;
     auto getComponent(const ComponentId index) const -> IComponent*;
     bool hasComponent(const ComponentId index) const;
     void destroy();
@@ -95,28 +140,37 @@ protected:
 
     void reactivate(unsigned creationIndex)
     {
-        enabled_ = true;
+        record_->enabled = true;
         uuid_ = creationIndex;
     }
-    
+
     unsigned int uuid_{ 0 };
-    bool enabled_{ true };
 
 private:
     ComponentPool& getComponentPool(const ComponentId index) const;
     /// Replace a given component
     void replace(const ComponentId index, IComponent* replacement);
-
-    EntityPtrWeak instance_;
-    std::map<ComponentId, IComponent*> components_;
-    /// componentPools is set by the context which created the entity and
-    /// is used to reuse removed components.
-    /// Removed components will be pushed to the componentPool.
+    void markDirty(const ComponentId index);
+
+    /// Strong reference to itself while enabled, so events can hand out
+    /// a reference instead of locking a weak pointer.
+    /// The context owns enabled entities anyway; destroy() drops it.
+    EntityPtr instance_;
+    /// Components modified in place and not reported yet
+    ComponentMask dirty_;
+    /// Components with data only, tags are just a bit in the signature
+    std::map<ComponentId, IComponent*, std::less<ComponentId>, NodePoolAllocator<std::pair<const ComponentId, IComponent*>>> components_;
+    /// The context which created the entity. It gets notified directly
+    /// about component changes and its component pools are used to reuse
+    /// removed components.
     /// Use entity.CreateComponent(index, type) to get a new or
     /// reusable component from the componentPool.
     /// Use entity.GetComponentPool(index) to get a componentPool for
     /// a specific component index.
-    ComponentPools& componentPools_;
+    Context* context_;
+    /// Signature and enabled flag live in the context's record table
+    EntityRecord* record_;
+    std::uint32_t slot_;
 };
 
 /* -------------------------------------------------------------------------- */
@@ -124,14 +178,22 @@ private:
 template <typename T, typename... TArgs>
 auto Entity::createComponent(TArgs&&... args) -> IComponent*
 {
-    auto& componentPool = getComponentPool(ComponentTypeId::get<T>());
     IComponent* component{ nullptr };
 
-    if (componentPool.size() > 0) {
-        component = componentPool.top();
-        componentPool.pop();
+    if (ComponentTypeId::isTag<T>()) {
+        // Nothing to allocate, all entities share the same instance
+        component = ComponentTypeId::getTagInstance(ComponentTypeId::get<T>());
     } else {
-        component = new T();
+        auto& componentPool = getComponentPool(ComponentTypeId::get<T>());
+
+        if (componentPool.size() > 0) {
+            component = componentPool.top();
+            componentPool.pop();
+            ENTITAS_COUNT(ComponentPoolHits);
+        } else {
+            component = new T();
+            ENTITAS_COUNT(ComponentPoolMisses);
+        }
     }
 
     (static_cast<T*>(component))->reset(std::forward<TArgs>(args)...);
@@ -140,25 +202,25 @@ auto Entity::createComponent(TArgs&&... args) -> IComponent*
 }
 
 template <typename T, typename... TArgs>
-auto Entity::add(TArgs&&... args) -> EntityPtr
+auto Entity::add(TArgs&&... args) -> const EntityPtr&
 {
     return addComponent(ComponentTypeId::get<T>(), createComponent<T>(std::forward<TArgs>(args)...));
 }
 
 template <typename T>
-auto Entity::remove() -> EntityPtr
+auto Entity::remove() -> const EntityPtr&
 {
     return removeComponent(ComponentTypeId::get<T>());
 }
 
 template <typename T, typename... TArgs>
-auto Entity::replace(TArgs&&... args) -> EntityPtr
+auto Entity::replace(TArgs&&... args) -> const EntityPtr&
 {
     return replaceComponent(ComponentTypeId::get<T>(), createComponent<T>(std::forward<TArgs>(args)...));
 }
 
 template <typename T>
-auto Entity::refresh() -> EntityPtr
+auto Entity::refresh() -> const EntityPtr&
 {
     return replaceComponent(ComponentTypeId::get<T>(), get<T>());
 }
@@ -169,11 +231,24 @@ auto Entity::get() const -> T*
     return static_cast<T*>(getComponent(ComponentTypeId::get<T>()));
 }
 
+template <typename T>
+auto Entity::modify() -> T&
+{
+    auto index = ComponentTypeId::get<T>();
+    auto component = static_cast<T*>(getComponent(index));
+
+    if (!dirty_.test(index)) {
+        markDirty(index);
+    }
+
+    return *component;
+}
+
 template <typename T>
 auto Entity::use() -> T*
 {
     refresh<T>();
-    return static_cast<T*>(getComponent(ComponentTypeId::get<T>()));
+    return get<T>();
 }
 
 template <typename T>
@@ -0,0 +1,345 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "Collector.hpp"
+#include "Group.hpp"
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace entitas {
+
+/// Base class of all entity indices.
+/// Use context.addEntityIndex(name, index) to register an index and
+/// context.getEntityIndex(name) to get it back.
+class IEntityIndex {
+public:
+    virtual ~IEntityIndex() = default;
+
+    virtual void activate() = 0;
+    virtual void deactivate() = 0;
+};
+
+/// Keeps entities of a group indexed by a key taken from one of their
+/// components. The index is kept up to date by listening to the events
+/// of the group, so the component must be part of the group's matcher.
+template <typename TComponent, typename TKey>
+class AbstractEntityIndex : public IEntityIndex, public Indexed {
+public:
+    using GetKey = std::function<TKey(const TComponent&)>;
+
+    AbstractEntityIndex(Group::SharedPtr group, GetKey getKey);
+    ~AbstractEntityIndex();
+
+    /// Indexes all entities that are already in the group and starts
+    /// listening to its changes. Indices are activated by default.
+    void activate() override;
+    /// Stops listening to the group and removes all indexed entities.
+    void deactivate() override;
+
+protected:
+    virtual void addEntity(const TKey& key, const EntityPtr& entity) = 0;
+    virtual void removeEntity(const TKey& key, const EntityPtr& entity) = 0;
+    /// Called when the key of an entity changes
+    virtual void updateEntity(const TKey& previousKey, const TKey& newKey, const EntityPtr& entity);
+    virtual void clear() = 0;
+
+private:
+    /// The component passed with group events is the one that changed,
+    /// which is not necessarily the one we index by.
+    TKey getKeyFor(const EntityPtr& entity, ComponentId index, IComponent* component) const;
+    void unsubscribe();
+
+    void onEntityAdded(const Group::SharedPtr& group, const EntityPtr& entity, ComponentId index, IComponent* component);
+    void onEntityRemoved(const Group::SharedPtr& group, const EntityPtr& entity, ComponentId index, IComponent* component);
+    void onEntityUpdated(const Group::SharedPtr& group, const EntityPtr& entity, ComponentId index, IComponent* previousComponent, IComponent* newComponent);
+
+    Group::WeakPtr group_;
+    GetKey getKey_;
+    /// Key each entity is indexed under. Components modified in place are
+    /// reported with the same previous and new component, so the previous
+    /// key can't be computed from the event.
+    std::unordered_map<Entity*, TKey> keys_;
+
+    std::function<void(const Group::SharedPtr&, const EntityPtr&, ComponentId, IComponent*)> onEntityAddedCache_;
+    std::function<void(const Group::SharedPtr&, const EntityPtr&, ComponentId, IComponent*)> onEntityRemovedCache_;
+    std::function<void(const Group::SharedPtr&, const EntityPtr&, ComponentId, IComponent*, IComponent*)> onEntityUpdatedCache_;
+};
+
+/* -------------------------------------------------------------------------- */
+
+/// An index where every key maps to exactly one entity,
+/// e.g. the entity with PlayerId == 42.
+/// Adding a second entity with the same key throws.
+template <typename TComponent, typename TKey, typename THash = std::hash<TKey>>
+class PrimaryEntityIndex : public AbstractEntityIndex<TComponent, TKey> {
+public:
+    using GetKey = typename AbstractEntityIndex<TComponent, TKey>::GetKey;
+
+    PrimaryEntityIndex(Group::SharedPtr group, GetKey getKey);
+    ~PrimaryEntityIndex();
+
+    bool hasEntity(const TKey& key) const;
+    /// Returns the entity for the given key or nullptr if there is none.
+    auto getEntity(const TKey& key) const -> EntityPtr;
+    auto count() const -> unsigned int;
+
+protected:
+    void addEntity(const TKey& key, const EntityPtr& entity) override;
+    void removeEntity(const TKey& key, const EntityPtr& entity) override;
+    void clear() override;
+
+private:
+    std::unordered_map<TKey, EntityPtr, THash> index_;
+};
+
+/* -------------------------------------------------------------------------- */
+
+/// An index where every key maps to any number of entities,
+/// e.g. all the entities owned by a given team.
+template <typename TComponent, typename TKey, typename THash = std::hash<TKey>>
+class EntityIndex : public AbstractEntityIndex<TComponent, TKey> {
+public:
+    using GetKey = typename AbstractEntityIndex<TComponent, TKey>::GetKey;
+    using IndexedEntities = std::unordered_set<EntityPtr>;
+
+    EntityIndex(Group::SharedPtr group, GetKey getKey);
+    ~EntityIndex();
+
+    /// Returns all entities for the given key. The set is empty if
+    /// there are none.
+    auto getEntities(const TKey& key) const -> const IndexedEntities&;
+
+protected:
+    void addEntity(const TKey& key, const EntityPtr& entity) override;
+    void removeEntity(const TKey& key, const EntityPtr& entity) override;
+    void clear() override;
+
+private:
+    std::unordered_map<TKey, IndexedEntities, THash> index_;
+};
+
+/* -------------------------------------------------------------------------- */
+
+template <typename TComponent, typename TKey>
+AbstractEntityIndex<TComponent, TKey>::AbstractEntityIndex(Group::SharedPtr group, GetKey getKey)
+    : group_{ group }
+    , getKey_{ getKey }
+{
+    using namespace std::placeholders;
+    onEntityAddedCache_ = std::bind(&AbstractEntityIndex::onEntityAdded, this, _1, _2, _3, _4);
+    onEntityRemovedCache_ = std::bind(&AbstractEntityIndex::onEntityRemoved, this, _1, _2, _3, _4);
+    onEntityUpdatedCache_ = std::bind(&AbstractEntityIndex::onEntityUpdated, this, _1, _2, _3, _4, _5);
+}
+
+template <typename TComponent, typename TKey>
+AbstractEntityIndex<TComponent, TKey>::~AbstractEntityIndex()
+{
+    // Derived indices are already gone, so only stop listening here
+    unsubscribe();
+}
+
+template <typename TComponent, typename TKey>
+void AbstractEntityIndex<TComponent, TKey>::activate()
+{
+    auto group = group_.lock();
+    if (!group) {
+        return;
+    }
+
+    unsubscribe();
+    group->onEntityAdded += { index(), onEntityAddedCache_ };
+    group->onEntityRemoved += { index(), onEntityRemovedCache_ };
+    group->onEntityUpdated += { index(), onEntityUpdatedCache_ };
+
+    for (const auto& e : group->getEntities()) {
+        auto key = getKey_(*e->template get<TComponent>());
+        addEntity(key, e);
+        keys_[e.get()] = std::move(key);
+    }
+}
+
+template <typename TComponent, typename TKey>
+void AbstractEntityIndex<TComponent, TKey>::deactivate()
+{
+    unsubscribe();
+    clear();
+    keys_.clear();
+}
+
+template <typename TComponent, typename TKey>
+void AbstractEntityIndex<TComponent, TKey>::updateEntity(const TKey& previousKey, const TKey& newKey, const EntityPtr& entity)
+{
+    removeEntity(previousKey, entity);
+    addEntity(newKey, entity);
+}
+
+template <typename TComponent, typename TKey>
+auto AbstractEntityIndex<TComponent, TKey>::getKeyFor(const EntityPtr& entity, ComponentId index, IComponent* component) const -> TKey
+{
+    if (index == ComponentTypeId::get<TComponent>() && component != nullptr) {
+        return getKey_(*static_cast<TComponent*>(component));
+    }
+
+    return getKey_(*entity->template get<TComponent>());
+}
+
+template <typename TComponent, typename TKey>
+void AbstractEntityIndex<TComponent, TKey>::unsubscribe()
+{
+    // The group might already be destroyed if the index outlives the context
+    if (auto group = group_.lock()) {
+        group->onEntityAdded -= { index(), onEntityAddedCache_ };
+        group->onEntityRemoved -= { index(), onEntityRemovedCache_ };
+        group->onEntityUpdated -= { index(), onEntityUpdatedCache_ };
+    }
+}
+
+template <typename TComponent, typename TKey>
+void AbstractEntityIndex<TComponent, TKey>::onEntityAdded(const Group::SharedPtr& group, const EntityPtr& entity, ComponentId index, IComponent* component)
+{
+    auto key = getKeyFor(entity, index, component);
+    addEntity(key, entity);
+    keys_[entity.get()] = std::move(key);
+}
+
+template <typename TComponent, typename TKey>
+void AbstractEntityIndex<TComponent, TKey>::onEntityRemoved(const Group::SharedPtr& group, const EntityPtr& entity, ComponentId index, IComponent* component)
+{
+    auto it = keys_.find(entity.get());
+    if (it != keys_.end()) {
+        removeEntity(it->second, entity);
+        keys_.erase(it);
+    }
+}
+
+template <typename TComponent, typename TKey>
+void AbstractEntityIndex<TComponent, TKey>::onEntityUpdated(const Group::SharedPtr& group, const EntityPtr& entity, ComponentId index, IComponent* previousComponent, IComponent* newComponent)
+{
+    // Replacing any other component can't change the key
+    if (index != ComponentTypeId::get<TComponent>()) {
+        return;
+    }
+
+    auto it = keys_.find(entity.get());
+    if (it == keys_.end()) {
+        return;
+    }
+
+    auto key = getKeyFor(entity, index, newComponent);
+    if (!(key == it->second)) {
+        updateEntity(it->second, key, entity);
+        it->second = std::move(key);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+template <typename TComponent, typename TKey, typename THash>
+PrimaryEntityIndex<TComponent, TKey, THash>::PrimaryEntityIndex(Group::SharedPtr group, GetKey getKey)
+    : AbstractEntityIndex<TComponent, TKey>(group, getKey)
+{
+    this->activate();
+}
+
+template <typename TComponent, typename TKey, typename THash>
+PrimaryEntityIndex<TComponent, TKey, THash>::~PrimaryEntityIndex()
+{
+    this->deactivate();
+}
+
+template <typename TComponent, typename TKey, typename THash>
+bool PrimaryEntityIndex<TComponent, TKey, THash>::hasEntity(const TKey& key) const
+{
+    return index_.find(key) != index_.end();
+}
+
+template <typename TComponent, typename TKey, typename THash>
+auto PrimaryEntityIndex<TComponent, TKey, THash>::getEntity(const TKey& key) const -> EntityPtr
+{
+    auto it = index_.find(key);
+    return it != index_.end() ? it->second : nullptr;
+}
+
+template <typename TComponent, typename TKey, typename THash>
+auto PrimaryEntityIndex<TComponent, TKey, THash>::count() const -> unsigned int
+{
+    return static_cast<unsigned>(index_.size());
+}
+
+template <typename TComponent, typename TKey, typename THash>
+void PrimaryEntityIndex<TComponent, TKey, THash>::addEntity(const TKey& key, const EntityPtr& entity)
+{
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        index_.emplace(key, entity);
+    } else if (it->second != entity) {
+        throw std::runtime_error("Error, cannot add entity to primary entity index, key already exists");
+    }
+}
+
+template <typename TComponent, typename TKey, typename THash>
+void PrimaryEntityIndex<TComponent, TKey, THash>::removeEntity(const TKey& key, const EntityPtr& entity)
+{
+    auto it = index_.find(key);
+    if (it != index_.end() && it->second == entity) {
+        index_.erase(it);
+    }
+}
+
+template <typename TComponent, typename TKey, typename THash>
+void PrimaryEntityIndex<TComponent, TKey, THash>::clear()
+{
+    index_.clear();
+}
+
+/* -------------------------------------------------------------------------- */
+
+template <typename TComponent, typename TKey, typename THash>
+EntityIndex<TComponent, TKey, THash>::EntityIndex(Group::SharedPtr group, GetKey getKey)
+    : AbstractEntityIndex<TComponent, TKey>(group, getKey)
+{
+    this->activate();
+}
+
+template <typename TComponent, typename TKey, typename THash>
+EntityIndex<TComponent, TKey, THash>::~EntityIndex()
+{
+    this->deactivate();
+}
+
+template <typename TComponent, typename TKey, typename THash>
+auto EntityIndex<TComponent, TKey, THash>::getEntities(const TKey& key) const -> const IndexedEntities&
+{
+    static const IndexedEntities empty;
+    auto it = index_.find(key);
+    return it != index_.end() ? it->second : empty;
+}
+
+template <typename TComponent, typename TKey, typename THash>
+void EntityIndex<TComponent, TKey, THash>::addEntity(const TKey& key, const EntityPtr& entity)
+{
+    index_[key].insert(entity);
+}
+
+template <typename TComponent, typename TKey, typename THash>
+void EntityIndex<TComponent, TKey, THash>::removeEntity(const TKey& key, const EntityPtr& entity)
+{
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        it->second.erase(entity);
+        if (it->second.empty()) {
+            index_.erase(it);
+        }
+    }
+}
+
+template <typename TComponent, typename TKey, typename THash>
+void EntityIndex<TComponent, TKey, THash>::clear()
+{
+    index_.clear();
+}
+}
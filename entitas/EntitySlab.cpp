@@ -0,0 +1,96 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#include "EntitySlab.hpp"
+#include <new>
+
+namespace entitas {
+
+EntitySlab::EntitySlab(Context* context)
+    : context_{ context }
+    , lifetime_{ std::make_shared<Lifetime>(Lifetime{ context, {} }) }
+{
+}
+
+EntitySlab::~EntitySlab()
+{
+    std::vector<bool> released(capacity_, false);
+    for (; !freeSlots_.empty(); freeSlots_.pop()) {
+        released[freeSlots_.top()] = true;
+    }
+
+    // Entities still referenced are destroyed by their deleters
+    auto leftOver = false;
+    for (std::uint32_t slot = 0; slot < capacity_; ++slot) {
+        if (released[slot]) {
+            getRecord(slot).entity->~Entity();
+        } else {
+            leftOver = true;
+        }
+    }
+
+    lifetime_->context = nullptr;
+    if (leftOver) {
+        lifetime_->chunks = std::move(chunks_);
+    }
+}
+
+auto EntitySlab::acquire() -> Entity*
+{
+    if (!freeSlots_.empty()) {
+        auto slot = freeSlots_.top();
+        freeSlots_.pop();
+        return getRecord(slot).entity;
+    }
+
+    auto slot = capacity_;
+    if (slot % kChunkSize == 0) {
+        chunks_.emplace_back(new Chunk);
+    }
+
+    auto& chunk = *chunks_.back();
+    auto& record = chunk.records[slot % kChunkSize];
+    record.entity = new (&chunk.entities[slot % kChunkSize]) Entity(context_, &record, slot);
+    ++capacity_;
+
+    return record.entity;
+}
+
+void EntitySlab::release(Entity* entity)
+{
+    freeSlots_.push(entity->getSlot());
+}
+
+auto EntitySlab::getRecord(std::uint32_t slot) -> EntityRecord&
+{
+    return chunks_[slot / kChunkSize]->records[slot % kChunkSize];
+}
+
+auto EntitySlab::getRecord(std::uint32_t slot) const -> const EntityRecord&
+{
+    return chunks_[slot / kChunkSize]->records[slot % kChunkSize];
+}
+
+auto EntitySlab::capacity() const -> std::uint32_t
+{
+    return capacity_;
+}
+
+auto EntitySlab::getFreeCount() const -> unsigned int
+{
+    return static_cast<unsigned>(freeSlots_.size());
+}
+
+auto EntitySlab::getLifetime() const -> const std::shared_ptr<Lifetime>&
+{
+    return lifetime_;
+}
+
+auto EntitySlab::getMemoryBytes() const -> std::size_t
+{
+    // The priority queue does not expose the capacity of its vector
+    return chunks_.size() * sizeof(Chunk) + chunks_.capacity() * sizeof(std::unique_ptr<Chunk>)
+        + freeSlots_.size() * sizeof(std::uint32_t);
+}
+}
@@ -0,0 +1,98 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "Entity.hpp"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <type_traits>
+#include <vector>
+
+namespace entitas {
+
+static_assert(ENTITAS_MAX_COMPONENTS > 64 || ENTITAS_MAX_GROUPS > 64 || sizeof(EntityRecord) <= 32,
+    "EntityRecord should fit in half a cache line");
+
+/// Owns the Entity objects of a context and their records.
+/// Entities and records are allocated in fixed size chunks, so entities
+/// created together sit together in memory and never move. A released slot
+/// keeps its Entity object for reuse, and the lowest free slot is always
+/// handed out first to keep the table dense.
+class EntitySlab {
+    struct Chunk;
+
+public:
+    static const std::uint32_t kChunkSize = 256;
+
+    /// Shared with the deleters of the entity pointers, so the ones that
+    /// outlive the context still find their entities. 'context' is null
+    /// once the slab is gone, the chunks of the entities left over are
+    /// freed with the last of them.
+    struct Lifetime {
+        Context* context;
+        std::vector<std::unique_ptr<Chunk>> chunks;
+    };
+
+    EntitySlab(Context* context);
+    ~EntitySlab();
+
+    EntitySlab(const EntitySlab&) = delete;
+    EntitySlab& operator=(const EntitySlab&) = delete;
+
+    /// Returns the entity of the lowest free slot,
+    /// constructing it if the slot was never used.
+    auto acquire() -> Entity*;
+    /// Makes the slot of a destroyed entity available again.
+    void release(Entity* entity);
+
+    auto getRecord(std::uint32_t slot) -> EntityRecord&;
+    auto getRecord(std::uint32_t slot) const -> const EntityRecord&;
+    /// Number of slots ever used, all of them hold a constructed entity
+    auto capacity() const -> std::uint32_t;
+    auto getFreeCount() const -> unsigned int;
+    /// Bytes of the chunks and of the slot bookkeeping, not what the
+    /// entities allocate themselves
+    auto getMemoryBytes() const -> std::size_t;
+    auto getLifetime() const -> const std::shared_ptr<Lifetime>&;
+
+    /// Calls 'fn' with the record of every used slot, in slot order
+    template <typename F>
+    void forEachRecord(F fn) const;
+    template <typename F>
+    void forEachRecord(F fn);
+
+private:
+    using EntityStorage = typename std::aligned_storage<sizeof(Entity), alignof(Entity)>::type;
+
+    struct Chunk {
+        EntityRecord records[kChunkSize];
+        EntityStorage entities[kChunkSize];
+    };
+
+    Context* context_;
+    std::shared_ptr<Lifetime> lifetime_;
+    std::vector<std::unique_ptr<Chunk>> chunks_;
+    std::uint32_t capacity_{ 0 };
+    std::priority_queue<std::uint32_t, std::vector<std::uint32_t>, std::greater<std::uint32_t>> freeSlots_;
+};
+
+template <typename F>
+void EntitySlab::forEachRecord(F fn) const
+{
+    for (std::uint32_t slot = 0; slot < capacity_; ++slot) {
+        fn(chunks_[slot / kChunkSize]->records[slot % kChunkSize]);
+    }
+}
+
+template <typename F>
+void EntitySlab::forEachRecord(F fn)
+{
+    for (std::uint32_t slot = 0; slot < capacity_; ++slot) {
+        fn(chunks_[slot / kChunkSize]->records[slot % kChunkSize]);
+    }
+}
+}
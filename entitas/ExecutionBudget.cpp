@@ -0,0 +1,57 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#include "ExecutionBudget.hpp"
+#include <algorithm>
+
+namespace entitas {
+
+ExecutionBudget::ExecutionBudget(const ExecutionLimits& limits)
+    : remainingItems_{ limits.items }
+{
+    if (limits.time.count() > 0) {
+        deadline_ = Clock::now() + limits.time;
+    }
+}
+
+auto ExecutionBudget::limitedTo(const ExecutionLimits& limits) const -> ExecutionBudget
+{
+    auto budget = ExecutionBudget(limits);
+    budget.deadline_ = std::min(budget.deadline_, deadline_);
+    budget.remainingItems_ = std::min(budget.remainingItems_, remainingItems_);
+    return budget;
+}
+
+bool ExecutionBudget::isExhausted() const
+{
+    if (remainingItems_ == 0) {
+        return true;
+    }
+
+    return deadline_ != Clock::time_point::max() && Clock::now() >= deadline_;
+}
+
+void ExecutionBudget::consume(std::size_t items)
+{
+    if (remainingItems_ != ExecutionLimits::kUnlimitedItems) {
+        remainingItems_ -= std::min(items, remainingItems_);
+    }
+    consumedItems_ += items;
+}
+
+auto ExecutionBudget::getRemainingItems() const -> std::size_t
+{
+    return remainingItems_;
+}
+
+auto ExecutionBudget::getConsumedItems() const -> std::size_t
+{
+    return consumedItems_;
+}
+
+auto ExecutionBudget::getDeadline() const -> Clock::time_point
+{
+    return deadline_;
+}
+}
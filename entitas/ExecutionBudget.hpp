@@ -0,0 +1,47 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <limits>
+
+namespace entitas {
+
+/// Per call limits of a budgeted system, zero time means no time limit
+struct ExecutionLimits {
+    static const std::size_t kUnlimitedItems = std::numeric_limits<std::size_t>::max();
+
+    std::chrono::microseconds time{ 0 };
+    std::size_t items{ kUnlimitedItems };
+};
+
+/// Work a budgeted system may still do in the current frame: a deadline
+/// and a number of items. Systems consume items as they process them and
+/// stop once the budget is exhausted.
+class ExecutionBudget {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Unlimited
+    ExecutionBudget() = default;
+    /// Starts counting the time now
+    explicit ExecutionBudget(const ExecutionLimits& limits);
+
+    /// Returns a budget within both this one and the given limits
+    auto limitedTo(const ExecutionLimits& limits) const -> ExecutionBudget;
+
+    bool isExhausted() const;
+    void consume(std::size_t items = 1);
+    auto getRemainingItems() const -> std::size_t;
+    auto getConsumedItems() const -> std::size_t;
+    auto getDeadline() const -> Clock::time_point;
+
+private:
+    Clock::time_point deadline_{ Clock::time_point::max() };
+    std::size_t remainingItems_{ ExecutionLimits::kUnlimitedItems };
+    std::size_t consumedItems_{ 0 };
+};
+}
@@ -0,0 +1,441 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#include "FlightRecorder.hpp"
+
+#ifdef ENTITAS_FLIGHT_RECORDER
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+namespace entitas {
+namespace detail {
+    std::atomic<bool> gFlightRecorderEnabled{ true };
+}
+
+namespace {
+    using Clock = FlightRecorder::Clock;
+    using EventType = FlightRecorder::EventType;
+
+    /// Rings of exited threads kept around for the next dumps
+    const std::size_t kRetiredRingsCount = 8;
+
+    struct ThreadEvent {
+        detail::FlightRing::Event event;
+        unsigned int threadIndex;
+    };
+
+    /// What a dump writes, copied so that it is written without the lock
+    struct Snapshot {
+        std::vector<ThreadEvent> events;
+        std::vector<std::string> names;
+        double nanosecondsPerTick;
+    };
+
+    struct HitchDump {
+        std::string path;
+        Snapshot snapshot;
+    };
+
+    struct Registry {
+        /// Ticks are converted to time by comparing them with the clock
+        /// since then
+        std::uint64_t originTicks{ FlightRecorder::getTicks() };
+        Clock::time_point originTime{ Clock::now() };
+
+        std::mutex mutex;
+        std::vector<detail::FlightRing*> rings;
+        std::deque<std::unique_ptr<detail::FlightRing>> retired;
+        unsigned int nextThreadIndex{ 1 };
+
+        std::vector<std::string> names{ "" };
+        std::unordered_map<std::string, FlightRecorder::NameId> nameIds;
+
+        std::string hitchPath;
+        double hitchSeconds{ 2.0 };
+        Clock::time_point lastHitchDump{};
+        unsigned long hitchDumpsCount{ 0 };
+
+        /// Taken by frame threads and written by the hitch writer thread,
+        /// started on the first hitch
+        std::deque<HitchDump> hitchDumps;
+        bool hitchWriterStarted{ false };
+        unsigned long hitchDumpsWritten{ 0 };
+        std::condition_variable hitchDumpTaken;
+        std::condition_variable hitchDumpWritten;
+    };
+
+    auto getRegistry() -> Registry&
+    {
+        // Never destroyed, threads might exit after static destruction
+        static auto registry = new Registry();
+        return *registry;
+    }
+
+    std::atomic<std::size_t> gCapacity{ 1 << 14 };
+    std::atomic<std::int64_t> gHitchThreshold{ 0 };
+
+    /// Trivial, so still usable while an exiting thread destroys its other
+    /// thread locals
+    thread_local detail::FlightRing* tRing = nullptr;
+    thread_local unsigned int tFrameDepth = 0;
+    thread_local Clock::time_point tFrameStart;
+
+    /// Takes the events of threads that are past retiring their ring,
+    /// never read
+    auto getDiscardRing() -> detail::FlightRing&
+    {
+        static auto ring = new detail::FlightRing(1, 0);
+        return *ring;
+    }
+
+    /// Hands the ring of the thread over to the registry when it exits
+    struct RingOwner {
+        std::unique_ptr<detail::FlightRing> ring;
+
+        ~RingOwner()
+        {
+            tRing = &getDiscardRing();
+            auto& registry = getRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.rings.erase(std::find(registry.rings.begin(), registry.rings.end(), ring.get()));
+            registry.retired.push_back(std::move(ring));
+            if (registry.retired.size() > kRetiredRingsCount) {
+                registry.retired.pop_front();
+            }
+        }
+    };
+
+    auto getType(std::uint64_t payload) -> EventType
+    {
+        return static_cast<EventType>(payload >> 56);
+    }
+
+    auto getNameId(std::uint64_t payload) -> FlightRecorder::NameId
+    {
+        return static_cast<FlightRecorder::NameId>((payload >> 32) & 0xffffffu);
+    }
+
+    auto getValue(std::uint64_t payload) -> std::uint32_t
+    {
+        return static_cast<std::uint32_t>(payload);
+    }
+
+    void writeJsonString(std::FILE* file, const std::string& value)
+    {
+        std::fputc('"', file);
+        for (auto c : value) {
+            if (c == '"' || c == '\\') {
+                std::fputc('\\', file);
+            }
+            std::fputc(c, file);
+        }
+        std::fputc('"', file);
+    }
+
+    auto getNanosecondsPerTick(const Registry& registry) -> double
+    {
+        auto ticks = FlightRecorder::getTicks() - registry.originTicks;
+        auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - registry.originTime).count();
+        return ticks > 0 ? elapsed / ticks : 1.0;
+    }
+
+    /// Called with the registry mutex held, only copies
+    auto takeSnapshot(Registry& registry, double seconds) -> Snapshot
+    {
+        Snapshot snapshot;
+        snapshot.nanosecondsPerTick = getNanosecondsPerTick(registry);
+        snapshot.names = registry.names;
+
+        auto window = static_cast<std::uint64_t>(seconds * 1e9 / snapshot.nanosecondsPerTick);
+        auto now = FlightRecorder::getTicks();
+        auto since = now > window ? now - window : 0;
+
+        std::vector<detail::FlightRing::Event> ringEvents;
+        auto append = [&](const detail::FlightRing& ring) {
+            ringEvents.clear();
+            ring.read(since, ringEvents);
+            for (const auto& event : ringEvents) {
+                snapshot.events.push_back(ThreadEvent{ event, ring.getThreadIndex() });
+            }
+        };
+
+        for (const auto& ring : registry.retired) {
+            append(*ring);
+        }
+        for (auto ring : registry.rings) {
+            append(*ring);
+        }
+
+        return snapshot;
+    }
+
+    auto takeSnapshot(double seconds) -> Snapshot
+    {
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        return takeSnapshot(registry, seconds);
+    }
+
+    void writeEvents(Snapshot& snapshot, std::FILE* file)
+    {
+        auto& events = snapshot.events;
+        std::stable_sort(events.begin(), events.end(), [](const ThreadEvent& left, const ThreadEvent& right) {
+            return left.event.time < right.event.time;
+        });
+
+        auto nanosecondsPerTick = snapshot.nanosecondsPerTick;
+        auto origin = events.empty() ? 0 : events.front().event.time;
+        auto getName = [&snapshot](FlightRecorder::NameId name) -> const std::string& {
+            static const std::string unknown{ "?" };
+            return name < snapshot.names.size() ? snapshot.names[name] : unknown;
+        };
+
+        static const char* phases[] = { "initialize", "execute", "cleanup", "teardown" };
+
+        std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+        auto first = true;
+        for (const auto& threadEvent : events) {
+            auto payload = threadEvent.event.payload;
+            auto type = getType(payload);
+            auto value = getValue(payload);
+            std::fprintf(file, "%s\n{\"name\":", first ? "" : ",");
+            first = false;
+
+            switch (type) {
+            case EventType::FrameBegin:
+            case EventType::FrameEnd:
+                std::fprintf(file, "\"frame\",\"cat\":\"frame\",\"ph\":\"%s\"", type == EventType::FrameBegin ? "B" : "E");
+                break;
+            case EventType::SystemBegin:
+            case EventType::SystemEnd:
+                writeJsonString(file, getName(getNameId(payload)));
+                std::fprintf(file, ",\"cat\":\"%s\",\"ph\":\"%s\"", value < 4 ? phases[value] : "system", type == EventType::SystemBegin ? "B" : "E");
+                break;
+            case EventType::GroupFlush:
+                std::fprintf(file, "\"group %u flush\",\"cat\":\"group\",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"changes\":%u}", getNameId(payload), value);
+                break;
+            case EventType::Bulk:
+                writeJsonString(file, getName(getNameId(payload)));
+                std::fprintf(file, ",\"cat\":\"bulk\",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"count\":%u}", value);
+                break;
+            default:
+                writeJsonString(file, getName(getNameId(payload)));
+                std::fprintf(file, ",\"cat\":\"mark\",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"value\":%u}", value);
+                break;
+            }
+
+            auto time = (threadEvent.event.time - origin) * nanosecondsPerTick / 1000.0;
+            std::fprintf(file, ",\"ts\":%.3f,\"pid\":1,\"tid\":%u}", time, threadEvent.threadIndex);
+        }
+        std::fprintf(file, "\n]}\n");
+    }
+
+    bool writeEvents(Snapshot& snapshot, const std::string& path)
+    {
+        auto file = std::fopen(path.c_str(), "w");
+        if (file == nullptr) {
+            return false;
+        }
+
+        writeEvents(snapshot, file);
+        return std::fclose(file) == 0;
+    }
+
+    /// Runs on the hitch writer thread, for good
+    void writeHitchDumps(Registry& registry)
+    {
+        std::unique_lock<std::mutex> lock(registry.mutex);
+        for (;;) {
+            registry.hitchDumpTaken.wait(lock, [&registry] { return !registry.hitchDumps.empty(); });
+            auto dump = std::move(registry.hitchDumps.front());
+            registry.hitchDumps.pop_front();
+
+            lock.unlock();
+            writeEvents(dump.snapshot, dump.path);
+            lock.lock();
+
+            ++registry.hitchDumpsWritten;
+            registry.hitchDumpWritten.notify_all();
+        }
+    }
+}
+
+namespace detail {
+    FlightRing::FlightRing(std::size_t capacity, unsigned int threadIndex)
+        : slots_{ new Slot[capacity] }
+        , mask_{ capacity - 1 }
+        , threadIndex_{ threadIndex }
+    {
+        for (std::size_t i = 0; i < capacity; ++i) {
+            slots_[i].time.store(0, std::memory_order_relaxed);
+            slots_[i].payload.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void FlightRing::read(std::uint64_t since, std::vector<Event>& events) const
+    {
+        auto capacity = mask_ + 1;
+        auto head = head_.load(std::memory_order_acquire);
+        auto begin = head > capacity ? head - capacity : 0;
+        auto offset = events.size();
+        for (auto i = begin; i < head; ++i) {
+            const auto& slot = slots_[i & mask_];
+            events.push_back(Event{ slot.time.load(std::memory_order_relaxed), slot.payload.load(std::memory_order_relaxed) });
+        }
+
+        // A slot read while the writer was overwriting it shows up as the
+        // writer having moved past its index
+        std::atomic_thread_fence(std::memory_order_acquire);
+        auto after = head_.load(std::memory_order_relaxed);
+        auto valid = after + 1 > capacity ? after + 1 - capacity : 0;
+        auto skipped = valid > begin ? std::min<std::uint64_t>(valid - begin, head - begin) : 0;
+
+        auto out = events.begin() + offset;
+        for (auto it = out + skipped; it != events.end(); ++it) {
+            if (it->time >= since) {
+                *out++ = *it;
+            }
+        }
+        events.erase(out, events.end());
+    }
+
+    auto getFlightRing() -> FlightRing&
+    {
+        if (tRing != nullptr) {
+            return *tRing;
+        }
+
+        static thread_local RingOwner owner;
+        auto& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        owner.ring.reset(new FlightRing(gCapacity.load(std::memory_order_relaxed), registry.nextThreadIndex++));
+        registry.rings.push_back(owner.ring.get());
+        tRing = owner.ring.get();
+        return *tRing;
+    }
+} // namespace detail
+
+auto FlightRecorder::getName(const std::string& name) -> NameId
+{
+    auto& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    auto it = registry.nameIds.find(name);
+    if (it != registry.nameIds.end()) {
+        return it->second;
+    }
+
+    auto id = static_cast<NameId>(registry.names.size());
+    if (id > 0xffffffu) {
+        throw std::runtime_error("Error, too many flight recorder names");
+    }
+    registry.names.push_back(name);
+    registry.nameIds.emplace(name, id);
+    return id;
+}
+
+void FlightRecorder::setEnabled(bool enabled)
+{
+    detail::gFlightRecorderEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool FlightRecorder::isEnabled()
+{
+    return detail::gFlightRecorderEnabled.load(std::memory_order_relaxed);
+}
+
+void FlightRecorder::setCapacity(std::size_t eventsCount)
+{
+    std::size_t capacity = 16;
+    while (capacity < eventsCount) {
+        capacity <<= 1;
+    }
+    gCapacity.store(capacity, std::memory_order_relaxed);
+}
+
+void FlightRecorder::beginFrame()
+{
+    if (tFrameDepth++ == 0) {
+        record(EventType::FrameBegin);
+        tFrameStart = Clock::now();
+    }
+}
+
+void FlightRecorder::endFrame()
+{
+    if (tFrameDepth == 0 || --tFrameDepth > 0) {
+        return;
+    }
+
+    record(EventType::FrameEnd);
+    auto threshold = gHitchThreshold.load(std::memory_order_relaxed);
+    if (threshold == 0 || !isEnabled()) {
+        return;
+    }
+
+    auto now = Clock::now();
+    if (now - tFrameStart < std::chrono::microseconds(threshold)) {
+        return;
+    }
+
+    auto& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    auto seconds = std::chrono::duration<double>(registry.hitchSeconds);
+    if (registry.hitchDumpsCount > 0 && now - registry.lastHitchDump < seconds) {
+        return;
+    }
+
+    registry.lastHitchDump = now;
+    ++registry.hitchDumpsCount;
+    registry.hitchDumps.push_back(HitchDump{ registry.hitchPath, takeSnapshot(registry, registry.hitchSeconds) });
+    if (!registry.hitchWriterStarted) {
+        // The registry is never destroyed, so neither is the writer
+        registry.hitchWriterStarted = true;
+        std::thread([&registry] { writeHitchDumps(registry); }).detach();
+    }
+    registry.hitchDumpTaken.notify_one();
+}
+
+void FlightRecorder::setHitchDump(std::chrono::microseconds threshold, const std::string& path, double seconds)
+{
+    auto& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.hitchPath = path;
+    registry.hitchSeconds = seconds;
+    gHitchThreshold.store(threshold.count(), std::memory_order_relaxed);
+}
+
+auto FlightRecorder::getHitchDumpsCount() -> unsigned long
+{
+    auto& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return registry.hitchDumpsCount;
+}
+
+void FlightRecorder::waitForHitchDumps()
+{
+    auto& registry = getRegistry();
+    std::unique_lock<std::mutex> lock(registry.mutex);
+    registry.hitchDumpWritten.wait(lock, [&registry] { return registry.hitchDumpsWritten == registry.hitchDumpsCount; });
+}
+
+bool FlightRecorder::dump(const std::string& path, double seconds)
+{
+    auto snapshot = takeSnapshot(seconds);
+    return writeEvents(snapshot, path);
+}
+
+void FlightRecorder::dump(std::FILE* file, double seconds)
+{
+    auto snapshot = takeSnapshot(seconds);
+    writeEvents(snapshot, file);
+}
+} // namespace entitas
+
+#endif
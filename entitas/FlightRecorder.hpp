@@ -0,0 +1,229 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#pragma once
+
+// Always-on recording of what the engine did lately, to find out what
+// happened during a rare hitch. Only compiled in when
+// ENTITAS_FLIGHT_RECORDER is defined, otherwise the macros at the end
+// expand to nothing.
+
+#ifdef ENTITAS_FLIGHT_RECORDER
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define ENTITAS_RECORDER_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define ENTITAS_RECORDER_TSC
+#endif
+
+namespace entitas {
+
+/// Every thread records compact events into its own fixed size ring,
+/// overwriting the oldest ones. Recording takes no lock and does not
+/// allocate once the ring of the thread exists. The rings are only read
+/// when dumping, which can happen at any time from any thread; events
+/// overwritten while they are being read are left out of the dump.
+/// Events are timed with the time stamp counter on x86, cheaper
+/// to read than the steady clock, and converted when dumping.
+class FlightRecorder {
+public:
+    using Clock = std::chrono::steady_clock;
+    /// Of a name registered with getName()
+    using NameId = std::uint32_t;
+
+    enum class EventType : std::uint8_t {
+        FrameBegin,
+        FrameEnd,
+        /// The name is the system, the value its Phase
+        SystemBegin,
+        SystemEnd,
+        /// The name is the index of the group, the value the number of
+        /// changes delivered
+        GroupFlush,
+        /// The value is the number of items processed
+        Bulk,
+        Mark
+    };
+
+    enum class Phase : std::uint32_t {
+        Initialize,
+        Execute,
+        Cleanup,
+        Teardown
+    };
+
+    /// Returns the same id for the same name. Takes a lock, get ids once
+    /// and keep them.
+    static auto getName(const std::string& name) -> NameId;
+
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+    /// Events per ring, rounded up to a power of two, 16384 by default.
+    /// Only rings of threads that did not record yet get the new size.
+    static void setCapacity(std::size_t eventsCount);
+
+    static void record(EventType type, NameId name = 0, std::uint32_t value = 0);
+    /// Time stamp counter or steady clock ticks
+    static auto getTicks() -> std::uint64_t;
+    /// Frames nest, only the outermost one counts
+    static void beginFrame();
+    static void endFrame();
+
+    /// A frame longer than 'threshold' dumps the last 'seconds' to 'path',
+    /// at most once per 'seconds'. The thread ending the frame only copies
+    /// the events, a writer thread writes the file. A zero threshold turns
+    /// it off, the default.
+    static void setHitchDump(std::chrono::microseconds threshold, const std::string& path, double seconds = 2.0);
+    /// Of the hitch dumps taken, written or not
+    static auto getHitchDumpsCount() -> unsigned long;
+    /// Until the hitch dumps taken so far are written, dumps still queued
+    /// when the program exits are lost
+    static void waitForHitchDumps();
+
+    /// Writes the events of the last 'seconds' of all threads in the Chrome
+    /// trace event format, which chrome://tracing and Perfetto open
+    static bool dump(const std::string& path, double seconds);
+    static void dump(std::FILE* file, double seconds);
+};
+
+namespace detail {
+    /// The ring of one thread, written only by it
+    class FlightRing {
+    public:
+        FlightRing(std::size_t capacity, unsigned int threadIndex);
+
+        void push(std::uint64_t time, std::uint64_t payload)
+        {
+            auto head = head_.load(std::memory_order_relaxed);
+            // Readers that see this write also see 'head', so they know
+            // the slot is being overwritten
+            std::atomic_thread_fence(std::memory_order_release);
+            auto& slot = slots_[head & mask_];
+            slot.time.store(time, std::memory_order_relaxed);
+            slot.payload.store(payload, std::memory_order_relaxed);
+            head_.store(head + 1, std::memory_order_release);
+        }
+
+        struct Event {
+            /// In ticks
+            std::uint64_t time;
+            std::uint64_t payload;
+        };
+
+        /// Appends the events recorded at 'since' or later, leaving out
+        /// those overwritten while reading
+        void read(std::uint64_t since, std::vector<Event>& events) const;
+
+        auto getThreadIndex() const -> unsigned int { return threadIndex_; }
+
+    private:
+        struct Slot {
+            std::atomic<std::uint64_t> time;
+            std::atomic<std::uint64_t> payload;
+        };
+
+        std::unique_ptr<Slot[]> slots_;
+        std::uint64_t mask_;
+        std::atomic<std::uint64_t> head_{ 0 };
+        unsigned int threadIndex_;
+    };
+
+    auto getFlightRing() -> FlightRing&;
+    extern std::atomic<bool> gFlightRecorderEnabled;
+} // namespace detail
+
+inline auto FlightRecorder::getTicks() -> std::uint64_t
+{
+#ifdef ENTITAS_RECORDER_TSC
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(Clock::now().time_since_epoch().count());
+#endif
+}
+
+inline void FlightRecorder::record(EventType type, NameId name, std::uint32_t value)
+{
+    if (!detail::gFlightRecorderEnabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    auto payload = (static_cast<std::uint64_t>(type) << 56) | (static_cast<std::uint64_t>(name & 0xffffffu) << 32) | value;
+    detail::getFlightRing().push(getTicks(), payload);
+}
+
+/// Records the begin and the end of a system call
+class FlightSystemScope {
+public:
+    FlightSystemScope(FlightRecorder::NameId name, FlightRecorder::Phase phase)
+        : name_{ name }
+        , phase_{ static_cast<std::uint32_t>(phase) }
+    {
+        FlightRecorder::record(FlightRecorder::EventType::SystemBegin, name_, phase_);
+    }
+
+    ~FlightSystemScope() { FlightRecorder::record(FlightRecorder::EventType::SystemEnd, name_, phase_); }
+
+    FlightSystemScope(const FlightSystemScope&) = delete;
+    FlightSystemScope& operator=(const FlightSystemScope&) = delete;
+
+private:
+    FlightRecorder::NameId name_;
+    std::uint32_t phase_;
+};
+
+class FlightFrameScope {
+public:
+    FlightFrameScope() { FlightRecorder::beginFrame(); }
+    ~FlightFrameScope() { FlightRecorder::endFrame(); }
+
+    FlightFrameScope(const FlightFrameScope&) = delete;
+    FlightFrameScope& operator=(const FlightFrameScope&) = delete;
+};
+} // namespace entitas
+
+#define ENTITAS_RECORDER_CONCAT_(a, b) a##b
+#define ENTITAS_RECORDER_CONCAT(a, b) ENTITAS_RECORDER_CONCAT_(a, b)
+
+#define ENTITAS_RECORD_FRAME() \
+    ::entitas::FlightFrameScope ENTITAS_RECORDER_CONCAT(entitasFlightFrame, __LINE__)
+/// Records the rest of the scope as a call of a system
+#define ENTITAS_RECORD_SYSTEM(name, phase) \
+    ::entitas::FlightSystemScope ENTITAS_RECORDER_CONCAT(entitasFlightSystem, __LINE__)(name, ::entitas::FlightRecorder::Phase::phase)
+/// Flushes that deliver nothing are left out
+#define ENTITAS_RECORD_GROUP_FLUSH(groupIndex, changesCount)                                                                 \
+    do {                                                                                                                     \
+        auto entitasChanges = static_cast<std::uint32_t>(changesCount);                                                      \
+        if (entitasChanges > 0) {                                                                                            \
+            ::entitas::FlightRecorder::record(::entitas::FlightRecorder::EventType::GroupFlush, groupIndex, entitasChanges); \
+        }                                                                                                                    \
+    } while (0)
+/// An operation over 'count' items, named by a NameId
+#define ENTITAS_RECORD_COUNT(name, count) \
+    ::entitas::FlightRecorder::record(::entitas::FlightRecorder::EventType::Bulk, name, static_cast<std::uint32_t>(count))
+/// Same with a fixed name, registered on first use
+#define ENTITAS_RECORD_BULK(name, count)                                      \
+    do {                                                                      \
+        static const auto entitasName = ::entitas::FlightRecorder::getName(name); \
+        ENTITAS_RECORD_COUNT(entitasName, count);                             \
+    } while (0)
+
+#else
+
+#define ENTITAS_RECORD_FRAME()
+#define ENTITAS_RECORD_SYSTEM(name, phase)
+#define ENTITAS_RECORD_GROUP_FLUSH(groupIndex, changesCount)
+#define ENTITAS_RECORD_COUNT(name, count)
+#define ENTITAS_RECORD_BULK(name, count)
+
+#endif
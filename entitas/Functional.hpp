@@ -9,14 +9,16 @@
 #ifndef Functional_h
 #define Functional_h
 
+#include <algorithm>
+
 template <typename Collection,typename unop>
-inline void for_each(Collection col, unop op){
+inline void for_each(const Collection& col, unop op){
     std::for_each(col.begin(), col.end(), op);
 }
 
 
 template <typename Collection, typename E>
-inline bool doesExist(Collection col, E element){
+inline bool doesExist(const Collection& col, const E& element){
     return std::find(col.begin(), col.end(), element) != col.end();
 }
 
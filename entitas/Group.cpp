@@ -4,6 +4,7 @@
 
 #include "Group.hpp"
 #include "Collector.hpp"
+#include "FlightRecorder.hpp"
 #include "Functional.hpp"
 #include "Matcher.hpp"
 #include <algorithm>
@@ -17,13 +18,18 @@ Group::Group(const Matcher& matcher)
 
 auto Group::count() const -> unsigned int
 {
+    ++usage_.reads;
     return static_cast<unsigned>(entities_.size());
 }
 
 auto Group::getEntities() -> Entities&
 {
+    ++usage_.reads;
     if (entitiesCache_.empty() && !entities_.empty()) {
-        entitiesCache_ = Entities(entities_.begin(), entities_.end());
+        entitiesCache_.reserve(entities_.size());
+        for (auto e : entities_) {
+            entitiesCache_.push_back(e->instance_);
+        }
     }
 
     return entitiesCache_;
@@ -33,7 +39,7 @@ auto Group::getSingleEntity() const -> EntityPtr
 {
     auto c = count();
     if (c == 1) {
-        return *(entities_.begin());
+        return (*entities_.begin())->instance_;
     } else if (c == 0) {
         return nullptr;
     } else {
@@ -44,7 +50,16 @@ auto Group::getSingleEntity() const -> EntityPtr
 
 bool Group::containsEntity(const EntityPtr& entity) const
 {
-    return doesExist(entities_, entity);
+    return containsEntity(entity.get());
+}
+
+bool Group::containsEntity(Entity* entity) const
+{
+    if (groupIndex_ != kNoIndex) {
+        return entity->record_->groups.test(groupIndex_);
+    }
+
+    return entities_.find(entity) != entities_.end();
 }
 
 auto Group::getMatcher() const -> Matcher
@@ -54,21 +69,34 @@ auto Group::getMatcher() const -> Matcher
 
 auto Group::createCollector(const GroupEventType eventType) -> std::shared_ptr<Collector>
 {
-    return std::make_shared<Collector>(instance_.lock(), eventType);
+    return std::make_shared<Collector>(instance_, eventType);
+}
+
+auto Group::getUsage() const -> const Usage&
+{
+    return usage_;
+}
+
+auto Group::getSubscribersCount() const -> std::size_t
+{
+    return onEntityAdded.size() + onEntityUpdated.size() + onEntityRemoved.size()
+        + onEntitiesAdded.size() + onEntitiesUpdated.size() + onEntitiesRemoved.size();
 }
 
-void Group::setInstance(std::shared_ptr<Group> instance)
+void Group::setInstance(const SharedPtr& instance)
 {
     instance_ = instance;
 }
 
-auto Group::handleEntity(EntityPtr entity) -> GroupChanged*
+auto Group::handleEntity(const EntityPtr& entity) -> GroupChanged*
 {
+    ++usage_.evaluations;
     return matcher_.matches(entity) ? addEntity(entity) : removeEntity(entity);
 }
 
-void Group::handleEntitySilently(EntityPtr entity)
+void Group::handleEntitySilently(const EntityPtr& entity)
 {
+    ++usage_.evaluations;
     if (matcher_.matches(entity)) {
         addEntitySilently(entity);
     } else {
@@ -76,8 +104,9 @@ void Group::handleEntitySilently(EntityPtr entity)
     }
 }
 
-void Group::handleEntity(EntityPtr entity, ComponentId index, IComponent* component)
+void Group::handleEntity(const EntityPtr& entity, ComponentId index, IComponent* component)
 {
+    ++usage_.evaluations;
     if (matcher_.matches(entity)) {
         addEntity(entity, index, component);
     } else {
@@ -85,12 +114,52 @@ void Group::handleEntity(EntityPtr entity, ComponentId index, IComponent* compon
     }
 }
 
-void Group::updateEntity(EntityPtr entity, ComponentId index, IComponent* previousComponent, IComponent* newComponent)
+void Group::updateEntity(const EntityPtr& entity, ComponentId index, IComponent* previousComponent, IComponent* newComponent)
 {
+    // Nobody listens, nothing to do
+    if (onEntityUpdated.empty() && onEntitiesUpdated.empty()) {
+        return;
+    }
+
     if (containsEntity(entity)) {
-        onEntityRemoved(instance_.lock(), entity, index, previousComponent);
-        onEntityAdded(instance_.lock(), entity, index, newComponent);
-        onEntityUpdated(instance_.lock(), entity, index, previousComponent, newComponent);
+        onEntityUpdated(*owner_, entity, index, previousComponent, newComponent);
+        recordChange(onEntitiesUpdated, updatedChanges_, entity, index, newComponent);
+    }
+}
+
+void Group::notifyEntity(GroupChanged* event, const EntityPtr& entity, ComponentId index, IComponent* component)
+{
+    if (!event->empty()) {
+        (*event)(*owner_, entity, index, component);
+    }
+
+    if (event == &onEntityAdded) {
+        recordChange(onEntitiesAdded, addedChanges_, entity, index, component);
+    } else {
+        recordChange(onEntitiesRemoved, removedChanges_, entity, index, component);
+    }
+}
+
+void Group::takeChanges()
+{
+    addedChanges_.pending.swap(addedChanges_.delivered);
+    updatedChanges_.pending.swap(updatedChanges_.delivered);
+    removedChanges_.pending.swap(removedChanges_.delivered);
+}
+
+void Group::flush()
+{
+    ENTITAS_RECORD_GROUP_FLUSH(groupIndex_, addedChanges_.delivered.size() + updatedChanges_.delivered.size() + removedChanges_.delivered.size());
+    flushChanges(onEntitiesAdded, addedChanges_);
+    flushChanges(onEntitiesUpdated, updatedChanges_);
+    flushChanges(onEntitiesRemoved, removedChanges_);
+}
+
+void Group::updateUsage(unsigned long frame)
+{
+    if (usage_.reads != readsAtFrame_) {
+        usage_.lastReadFrame = frame;
+        readsAtFrame_ = usage_.reads;
     }
 }
 
@@ -102,51 +171,89 @@ void Group::removeAllEventHandlers()
     onEntityAdded.clear();
     onEntityRemoved.clear();
     onEntityUpdated.clear();
+    onEntitiesAdded.clear();
+    onEntitiesUpdated.clear();
+    onEntitiesRemoved.clear();
+
+    // Nobody is left to deliver them to
+    for (auto changes : { &addedChanges_, &updatedChanges_, &removedChanges_ }) {
+        changes->pending.clear();
+        changes->delivered.clear();
+    }
 }
 
-bool Group::addEntitySilently(EntityPtr entity)
+bool Group::addEntitySilently(const EntityPtr& entity)
 {
-    // True if insertion took place
-    if (entities_.insert(entity).second) {
-        // Since entity was added we must update cache
-        entitiesCache_.clear();
-        return true;
+    if (containsEntity(entity)) {
+        return false;
+    }
+
+    entities_.insert(entity.get());
+    ++usage_.added;
+    ENTITAS_COUNT(GroupEntitiesAdded);
+    if (groupIndex_ != kNoIndex) {
+        entity->record_->groups.set(groupIndex_);
     }
 
-    return false;
+    // Since entity was added we must update cache
+    entitiesCache_.clear();
+    return true;
 }
 
-void Group::addEntity(EntityPtr entity, ComponentId index, IComponent* component)
+void Group::addEntity(const EntityPtr& entity, ComponentId index, IComponent* component)
 {
     if (addEntitySilently(entity)) {
-        onEntityAdded(instance_.lock(), entity, index, component);
+        notifyEntity(&onEntityAdded, entity, index, component);
     }
 }
 
-auto Group::addEntity(EntityPtr entity) -> GroupChanged*
+auto Group::addEntity(const EntityPtr& entity) -> GroupChanged*
 {
     return addEntitySilently(entity) ? &onEntityAdded : nullptr;
 }
 
-bool Group::removeEntitySilently(EntityPtr entity)
+bool Group::removeEntitySilently(const EntityPtr& entity)
 {
-    if (entities_.erase(entity)) {
-        entitiesCache_.clear();
-        return true;
+    if (!containsEntity(entity)) {
+        // No entities were removed
+        return false;
     }
-    // No entities were removed
-    return false;
+
+    entities_.erase(entity.get());
+    ++usage_.removed;
+    ENTITAS_COUNT(GroupEntitiesRemoved);
+    if (groupIndex_ != kNoIndex) {
+        entity->record_->groups.reset(groupIndex_);
+    }
+
+    entitiesCache_.clear();
+    return true;
 }
 
-void Group::removeEntity(EntityPtr entity, ComponentId index, IComponent* component)
+void Group::removeEntity(const EntityPtr& entity, ComponentId index, IComponent* component)
 {
     if (removeEntitySilently(entity)) {
-        onEntityRemoved(instance_.lock(), entity, index, component);
+        notifyEntity(&onEntityRemoved, entity, index, component);
     }
 }
 
-auto Group::removeEntity(EntityPtr entity) -> GroupChanged*
+auto Group::removeEntity(const EntityPtr& entity) -> GroupChanged*
 {
     return removeEntitySilently(entity) ? &onEntityRemoved : nullptr;
 }
+
+void Group::recordChange(const GroupChangedBatch& event, ChangeList& changes, const EntityPtr& entity, ComponentId index, IComponent* component)
+{
+    if (!event.empty()) {
+        changes.pending.push_back(EntityChange{ entity, index, component });
+    }
+}
+
+void Group::flushChanges(GroupChangedBatch& event, ChangeList& changes)
+{
+    if (!changes.delivered.empty()) {
+        event(*owner_, changes.delivered);
+        changes.delivered.clear();
+    }
+}
 }
@@ -8,7 +8,7 @@
 #include "Entity.hpp"
 #include "GroupEventType.hpp"
 #include "Matcher.hpp"
-#include <unordered_set>
+#include "PoolAllocator.hpp"
 
 namespace entitas {
 class Collector;
@@ -26,6 +26,9 @@ class Group {
 public:
     using SharedPtr = std::shared_ptr<Group>;
     using WeakPtr = std::weak_ptr<Group>;
+    /// Group is not (or no longer) managed by a context
+    static const unsigned int kNoIndex = ~0u;
+
     Group(const Matcher& matcher);
     auto count() const -> unsigned int;
 
@@ -37,42 +40,120 @@ public:
     /// has more than one entity.
     auto getSingleEntity() const -> EntityPtr;
     
+    /// A single bit test on the entity's group mask, or a lookup for
+    /// groups without a bit
     bool containsEntity(const EntityPtr& entity) const;
     auto getMatcher() const -> Matcher;
     std::shared_ptr<Collector> createCollector(const GroupEventType eventType);
 
-    using GroupChanged = Delegate<void(SharedPtr group, EntityPtr entity, ComponentId index, IComponent* component)>;
-    using GroupUpdated = Delegate<void(SharedPtr group, EntityPtr entity, ComponentId index, IComponent* previousComponent, IComponent* newComponent)>;
+    /// What the group has been used for since it was created, see
+    /// Context::getGroupUsageReport()
+    struct Usage {
+        /// Calls to count(), getEntities() and getSingleEntity()
+        unsigned long reads{ 0 };
+        /// Entities tested against the matcher
+        unsigned long evaluations{ 0 };
+        unsigned long added{ 0 };
+        unsigned long removed{ 0 };
+        /// Flushes of the context before the group was created and before
+        /// it was last read, usually frame numbers
+        unsigned long createdFrame{ 0 };
+        unsigned long lastReadFrame{ 0 };
+    };
+
+    auto getUsage() const -> const Usage&;
+    /// Handlers of all the group events, collectors included
+    auto getSubscribersCount() const -> std::size_t;
+
+    // Events pass the group and the entity by reference, handlers that
+    // need to keep them around must copy the pointers themselves
+    using GroupChanged = Delegate<void(const SharedPtr& group, const EntityPtr& entity, ComponentId index, IComponent* component)>;
+    using GroupUpdated = Delegate<void(const SharedPtr& group, const EntityPtr& entity, ComponentId index, IComponent* previousComponent, IComponent* newComponent)>;
 
     /// Occurs when an entity gets added.
     GroupChanged onEntityAdded;
     /// Occurs when a component of an entity in the group gets replaced.
+    /// A replace only fires this event, the entity stays in the group.
+    /// Components changed in place are passed as both the previous and the
+    /// new component, see Entity::modify().
     GroupUpdated onEntityUpdated;
     /// Occurs when an entity gets removed.
     GroupChanged onEntityRemoved;
 
+    /// A change recorded for batched delivery. 'component' is the added,
+    /// replacing or removed component at the time of the change; by the time
+    /// the batch is delivered it may have been replaced or pooled again.
+    struct EntityChange {
+        EntityPtr entity;
+        ComponentId index;
+        IComponent* component;
+    };
+    using EntityChanges = std::vector<EntityChange>;
+    using GroupChangedBatch = Delegate<void(const SharedPtr& group, const EntityChanges& changes)>;
+
+    /// Batched versions of the events above. Changes are only recorded
+    /// while there are subscribers, and delivered all at once by
+    /// context.flush(). Entities might be destroyed by then.
+    GroupChangedBatch onEntitiesAdded;
+    GroupChangedBatch onEntitiesUpdated;
+    GroupChangedBatch onEntitiesRemoved;
+
 protected:
-    void setInstance(SharedPtr instance);
+    void setInstance(const SharedPtr& instance);
     // Returns callback or nullptr if entity was not added nor removed
-    auto handleEntity(EntityPtr entity) -> GroupChanged*;
+    auto handleEntity(const EntityPtr& entity) -> GroupChanged*;
     // Does not call callback
-    void handleEntitySilently(EntityPtr entity);
-    void handleEntity(EntityPtr entity, ComponentId index, IComponent* component);
+    void handleEntitySilently(const EntityPtr& entity);
+    void handleEntity(const EntityPtr& entity, ComponentId index, IComponent* component);
     /// Called by context
-    void updateEntity(EntityPtr entity, ComponentId index, IComponent* previousComponent, IComponent* newComponent);
+    void updateEntity(const EntityPtr& entity, ComponentId index, IComponent* previousComponent, IComponent* newComponent);
+    /// Fires an event returned by handleEntity()
+    void notifyEntity(GroupChanged* event, const EntityPtr& entity, ComponentId index, IComponent* component);
+    /// Takes the batched changes recorded so far, called by context.flush()
+    /// before anything gets delivered
+    void takeChanges();
+    /// Delivers the changes taken by takeChanges()
+    void flush();
+    /// Called by context.flush() with the frame that ends
+    void updateUsage(unsigned long frame);
     void removeAllEventHandlers();
 
 private:
-    bool addEntitySilently(EntityPtr entity); ///< Returns true if a given entity was added
-    void addEntity(EntityPtr entity, ComponentId index, IComponent* component);
-    auto addEntity(EntityPtr entity) -> GroupChanged*;
-    bool removeEntitySilently(EntityPtr entity); ///< Returns true if a given entity was removed
-    void removeEntity(EntityPtr entity, ComponentId index, IComponent* component);
-    auto removeEntity(EntityPtr entity) -> GroupChanged*;
-
-    std::weak_ptr<Group> instance_;
+    bool containsEntity(Entity* entity) const;
+    bool addEntitySilently(const EntityPtr& entity); ///< Returns true if a given entity was added
+    void addEntity(const EntityPtr& entity, ComponentId index, IComponent* component);
+    auto addEntity(const EntityPtr& entity) -> GroupChanged*;
+    bool removeEntitySilently(const EntityPtr& entity); ///< Returns true if a given entity was removed
+    void removeEntity(const EntityPtr& entity, ComponentId index, IComponent* component);
+    auto removeEntity(const EntityPtr& entity) -> GroupChanged*;
+    /// Changes are recorded in 'pending' and swapped to 'delivered' on
+    /// flush, so the handlers can record the next batch meanwhile
+    struct ChangeList {
+        EntityChanges pending;
+        EntityChanges delivered;
+    };
+
+    void recordChange(const GroupChangedBatch& event, ChangeList& changes, const EntityPtr& entity, ComponentId index, IComponent* component);
+    void flushChanges(GroupChangedBatch& event, ChangeList& changes);
+
+    WeakPtr instance_;
+    /// The context's reference to the group, handed out by the events.
+    /// Null once context.clearGroups() dropped the group.
+    const SharedPtr* owner_{ nullptr };
+    /// Bit of this group in the entities' group masks, set by the context
+    unsigned int groupIndex_{ kNoIndex };
     Matcher matcher_;
-    std::unordered_set<EntityPtr> entities_;
+    /// The context keeps every enabled entity alive and an entity leaves
+    /// all groups before it is destroyed, so groups don't retain entities
+    PooledSet<Entity*> entities_;
     Entities entitiesCache_;
+
+    ChangeList addedChanges_;
+    ChangeList updatedChanges_;
+    ChangeList removedChanges_;
+
+    /// Reads count from const methods too
+    mutable Usage usage_;
+    unsigned long readsAtFrame_{ 0 };
 };
 }
@@ -0,0 +1,30 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#include "GroupCursor.hpp"
+
+namespace entitas {
+
+GroupCursor::GroupCursor(Group::SharedPtr group)
+    : group_{ std::move(group) }
+{
+}
+
+void GroupCursor::restart()
+{
+    // Don't keep the entities alive until the next pass
+    pass_.clear();
+    position_ = 0;
+}
+
+auto GroupCursor::getRemainingCount() const -> std::size_t
+{
+    return pass_.size() - position_;
+}
+
+auto GroupCursor::getGroup() const -> const Group::SharedPtr&
+{
+    return group_;
+}
+}
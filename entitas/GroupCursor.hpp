@@ -0,0 +1,61 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "ExecutionBudget.hpp"
+#include "Group.hpp"
+
+namespace entitas {
+
+/// Walks a group across several frames, as far as each budget allows.
+/// A pass takes a snapshot of the group and visits every entity of it
+/// that is still in the group once, entities added meanwhile wait for the
+/// next pass. A new pass starts when the previous one completed.
+class GroupCursor {
+public:
+    GroupCursor(Group::SharedPtr group);
+
+    /// Calls fn(entity) for the next entities of the pass, consuming one
+    /// item each, until the pass completes or the budget is exhausted.
+    /// Returns true when the pass completed.
+    template <typename F>
+    inline bool forEach(ExecutionBudget& budget, F fn);
+
+    /// Drops the current pass, the next forEach() starts a new one
+    void restart();
+    /// Entities of the current pass not visited yet
+    auto getRemainingCount() const -> std::size_t;
+    auto getGroup() const -> const Group::SharedPtr&;
+
+private:
+    Group::SharedPtr group_;
+    Entities pass_;
+    std::size_t position_{ 0 };
+};
+
+template <typename F>
+bool GroupCursor::forEach(ExecutionBudget& budget, F fn)
+{
+    if (position_ == pass_.size()) {
+        pass_ = group_->getEntities();
+        position_ = 0;
+    }
+
+    while (position_ < pass_.size() && !budget.isExhausted()) {
+        const auto& entity = pass_[position_++];
+        if (group_->containsEntity(entity)) {
+            fn(entity);
+            budget.consume();
+        }
+    }
+
+    if (position_ < pass_.size()) {
+        return false;
+    }
+
+    restart();
+    return true;
+}
+}
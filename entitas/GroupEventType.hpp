@@ -11,6 +11,8 @@ enum class GroupEventType
 {
 	Added,
 	Removed,
-	AddedOrRemoved
+	AddedOrRemoved,
+	/// A component of an entity in the group got replaced
+	Updated
 };
 }
@@ -0,0 +1,27 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#include "GroupUsageReport.hpp"
+
+namespace entitas {
+void GroupUsageReport::print(std::FILE* file) const
+{
+    std::fprintf(file, "%zu groups after %lu frames\n", groups.size(), frame);
+
+    std::fprintf(file, "%-40s %10s %10s %10s %12s %10s %10s %6s %6s  %s\n",
+        "group", "entities", "reads", "idle", "evaluations", "added", "removed", "subs", "refs", "flags");
+    for (const auto& g : groups) {
+        const char* flags = g.dead ? "dead" : g.churning ? "churning" : "";
+        std::fprintf(file, "%-40s %10zu %10lu %10lu %12lu %10lu %10lu %6zu %6ld  %s\n", g.matcher.toString().c_str(),
+            g.entityCount, g.usage.reads, g.idleFrames, g.usage.evaluations, g.usage.added, g.usage.removed,
+            g.subscribersCount, g.holdersCount, flags);
+    }
+
+    for (const auto& duplicate : nearDuplicates) {
+        std::fprintf(file, "near duplicates: %s and %s (%zu component(s) apart%s)\n",
+            groups[duplicate.first].matcher.toString().c_str(), groups[duplicate.second].matcher.toString().c_str(),
+            duplicate.difference, duplicate.sameEntities ? ", same entities" : "");
+    }
+}
+} // namespace entitas
@@ -0,0 +1,63 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "Group.hpp"
+#include "Matcher.hpp"
+#include <cstdio>
+#include <vector>
+
+namespace entitas {
+
+/// How the groups of a context are used, see Context::getGroupUsageReport().
+/// Every group costs a matcher test on each change of its components,
+/// whether anybody reads it or not; this tells which ones pay off.
+struct GroupUsageReport {
+    struct Thresholds {
+        /// Frames without reads before a group without subscribers is dead
+        unsigned long deadFrames{ 60 };
+        /// Membership changes per read above which a group is churning
+        double churnPerRead{ 10.0 };
+        /// Below that many changes no group is churning
+        unsigned long minChurn{ 1000 };
+    };
+
+    struct GroupUsage {
+        Matcher matcher;
+        std::size_t entityCount;
+        Group::Usage usage;
+        std::size_t subscribersCount;
+        /// References to the group held outside the context
+        long holdersCount;
+        /// Frames since the last read, or since it was created if never read
+        unsigned long idleFrames;
+        /// Not read for a while and nobody subscribes to it
+        bool dead;
+        /// Changes a lot more than it is read, and nobody subscribes to it
+        bool churning;
+
+        auto getChurn() const -> unsigned long { return usage.added + usage.removed; }
+    };
+
+    /// Two groups whose matchers differ by a single component, or that
+    /// hold the same entities right now
+    struct NearDuplicate {
+        /// Indices in 'groups'
+        std::size_t first;
+        std::size_t second;
+        /// Components in one matcher but not in the other
+        std::size_t difference;
+        bool sameEntities;
+    };
+
+    /// Flushes of the context so far
+    unsigned long frame{ 0 };
+    /// In the order they were created
+    std::vector<GroupUsage> groups;
+    std::vector<NearDuplicate> nearDuplicates;
+
+    void print(std::FILE* file = stdout) const;
+};
+} // namespace entitas
@@ -0,0 +1,334 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#include "HardwareCounters.hpp"
+
+#ifdef ENTITAS_HARDWARE_COUNTERS
+
+#include <stdexcept>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+namespace entitas {
+namespace {
+#ifdef __linux__
+    struct EventConfig {
+        std::uint32_t type;
+        std::uint64_t config;
+    };
+
+    const EventConfig kEventConfigs[] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    };
+
+    auto openEvent(const EventConfig& event, int leader) -> int
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = event.type;
+        attr.config = event.config;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        // User space only, allowed without privileges at the default
+        // paranoia level
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.disabled = leader == -1 ? 1 : 0;
+
+        return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0));
+    }
+#endif
+}
+
+auto HardwareCounters::Values::getIpc() const -> double
+{
+    auto cycles = get(Event::Cycles);
+    return cycles > 0 ? static_cast<double>(get(Event::Instructions)) / cycles : 0.0;
+}
+
+auto HardwareCounters::Values::operator+=(const Values& other) -> Values&
+{
+    for (std::size_t i = 0; i < kEventCount; ++i) {
+        counts[i] += other.counts[i];
+    }
+    return *this;
+}
+
+auto HardwareCounters::Stats::getPerFrame(Event event) const -> double
+{
+    return frames > 0 ? static_cast<double>(total.get(event)) / frames : 0.0;
+}
+
+auto HardwareCounters::get() -> HardwareCounters&
+{
+    static HardwareCounters counters;
+    return counters;
+}
+
+auto HardwareCounters::getEventName(Event event) -> const char*
+{
+    switch (event) {
+    case Event::Cycles:
+        return "cycles";
+    case Event::Instructions:
+        return "instructions";
+    case Event::L1Misses:
+        return "L1 misses";
+    case Event::LLCMisses:
+        return "LLC misses";
+    case Event::BranchMisses:
+        return "branch misses";
+    default:
+        return "?";
+    }
+}
+
+HardwareCounters::HardwareCounters()
+{
+    fds_.fill(-1);
+    frameSystem_ = getSystem("frame");
+    open();
+}
+
+HardwareCounters::~HardwareCounters()
+{
+#ifdef __linux__
+    for (auto fd : fds_) {
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+#endif
+}
+
+void HardwareCounters::open()
+{
+#ifdef __linux__
+    for (std::size_t i = 0; i < kEventCount; ++i) {
+        auto fd = openEvent(kEventConfigs[i], leader_);
+        if (fd == -1) {
+            continue;
+        }
+
+        if (leader_ == -1) {
+            leader_ = fd;
+        }
+        fds_[i] = fd;
+        positions_[i] = openCount_++;
+    }
+
+    if (leader_ != -1) {
+        ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+}
+
+auto HardwareCounters::read() -> Sample
+{
+    Sample sample;
+#ifdef __linux__
+    if (leader_ == -1) {
+        return sample;
+    }
+
+    // Count, time enabled, time running and the values
+    std::uint64_t buffer[3 + kEventCount];
+    auto size = static_cast<ssize_t>((3 + openCount_) * sizeof(std::uint64_t));
+    if (::read(leader_, buffer, sizeof(buffer)) < size) {
+        return sample;
+    }
+
+    sample.enabled = buffer[1];
+    sample.running = buffer[2];
+    for (std::size_t i = 0; i < kEventCount; ++i) {
+        if (fds_[i] != -1) {
+            sample.counts[i] = buffer[3 + positions_[i]];
+        }
+    }
+    sample.valid = sample.running > 0;
+#endif
+    return sample;
+}
+
+bool HardwareCounters::getDelta(const Sample& start, const Sample& end, Values& delta)
+{
+    if (!start.valid || !end.valid || end.running <= start.running) {
+        return false;
+    }
+
+    // Scaled up when the kernel had to share the counters with others,
+    // by the share of the time in between they ran
+    auto enabled = end.enabled - start.enabled;
+    auto running = end.running - start.running;
+    auto scale = enabled > running ? static_cast<double>(enabled) / running : 1.0;
+    for (std::size_t i = 0; i < kEventCount; ++i) {
+        auto count = end.counts[i] > start.counts[i] ? end.counts[i] - start.counts[i] : 0;
+        delta.counts[i] = static_cast<std::uint64_t>(static_cast<double>(count) * scale);
+    }
+
+    return true;
+}
+
+bool HardwareCounters::isAvailable() const
+{
+    return leader_ != -1;
+}
+
+bool HardwareCounters::isAvailable(Event event) const
+{
+    return fds_[static_cast<std::size_t>(event)] != -1;
+}
+
+auto HardwareCounters::getSystem(const std::string& name) -> SystemId
+{
+    auto it = systemIds_.find(name);
+    if (it != systemIds_.end()) {
+        return it->second;
+    }
+
+    auto system = systems_.size();
+    systems_.emplace_back();
+    systems_.back().stats.name = name;
+    systemIds_.emplace(name, system);
+    return system;
+}
+
+void HardwareCounters::begin(SystemId system)
+{
+    open_.push_back(OpenSystem{ system, read() });
+}
+
+void HardwareCounters::end()
+{
+    auto sample = read();
+    if (open_.empty()) {
+        throw std::runtime_error("Error, hardware counters ended but none were begun");
+    }
+
+    auto open = open_.back();
+    open_.pop_back();
+    auto& system = systems_[open.system];
+    Values delta;
+    if (getDelta(open.start, sample, delta)) {
+        system.current += delta;
+        ++system.currentCalls;
+    } else {
+        ++system.currentMissed;
+    }
+
+    // Outside of frames every call is a frame of its own
+    if (frameDepth_ == 0) {
+        commit(system);
+    }
+}
+
+void HardwareCounters::beginFrame()
+{
+    if (frameDepth_++ == 0) {
+        frameStart_ = read();
+    }
+}
+
+void HardwareCounters::endFrame()
+{
+    if (frameDepth_ == 0 || --frameDepth_ > 0) {
+        return;
+    }
+
+    auto& frame = systems_[frameSystem_];
+    if (getDelta(frameStart_, read(), frame.current)) {
+        frame.currentCalls = 1;
+    } else {
+        frame.currentMissed = 1;
+    }
+
+    for (auto& system : systems_) {
+        commit(system);
+    }
+}
+
+void HardwareCounters::commit(System& system)
+{
+    system.stats.lastFrame = system.current;
+    system.stats.missed += system.currentMissed;
+    if (system.currentCalls > 0) {
+        system.stats.calls += system.currentCalls;
+        system.stats.total += system.current;
+        ++system.stats.frames;
+    }
+
+    system.current = Values{};
+    system.currentCalls = 0;
+    system.currentMissed = 0;
+}
+
+auto HardwareCounters::getStats(SystemId system) const -> Stats
+{
+    return systems_.at(system).stats;
+}
+
+auto HardwareCounters::getStats() const -> std::vector<Stats>
+{
+    std::vector<Stats> stats;
+    for (const auto& system : systems_) {
+        if (system.stats.calls > 0 || system.stats.missed > 0) {
+            stats.push_back(system.stats);
+        }
+    }
+
+    return stats;
+}
+
+void HardwareCounters::printStats(std::FILE* file) const
+{
+    if (!isAvailable()) {
+        std::fprintf(file, "Hardware counters are not available\n");
+        return;
+    }
+
+    std::fprintf(file, "%-40s %10s %8s", "", "frames", "missed");
+    for (std::size_t i = 0; i < kEventCount; ++i) {
+        std::fprintf(file, " %14s", getEventName(static_cast<Event>(i)));
+    }
+    std::fprintf(file, " %6s   (per frame)\n", "IPC");
+
+    for (const auto& stats : getStats()) {
+        std::fprintf(file, "%-40s %10lu %8lu", stats.name.c_str(), stats.frames, stats.missed);
+        for (std::size_t i = 0; i < kEventCount; ++i) {
+            auto event = static_cast<Event>(i);
+            if (isAvailable(event)) {
+                std::fprintf(file, " %14.0f", stats.getPerFrame(event));
+            } else {
+                std::fprintf(file, " %14s", "-");
+            }
+        }
+        std::fprintf(file, " %6.2f\n", stats.total.getIpc());
+    }
+}
+
+void HardwareCounters::reset()
+{
+    for (auto& system : systems_) {
+        auto name = std::move(system.stats.name);
+        system.stats = Stats{};
+        system.stats.name = std::move(name);
+        system.current = Values{};
+        system.currentCalls = 0;
+        system.currentMissed = 0;
+    }
+}
+} // namespace entitas
+
+#endif
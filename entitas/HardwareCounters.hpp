@@ -0,0 +1,186 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#pragma once
+
+// CPU counters per system, read through perf_event_open on Linux. Only
+// compiled in when ENTITAS_HARDWARE_COUNTERS is defined, otherwise the
+// macros at the end expand to nothing.
+
+#ifdef ENTITAS_HARDWARE_COUNTERS
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace entitas {
+
+/// Counts CPU events over the execute calls SystemContainer makes into its
+/// systems, summed up per frame. Counters are opened for the thread that
+/// uses them first and only count that thread, so work a system hands to
+/// other threads is not included.
+/// When the kernel denies access (see /proc/sys/kernel/perf_event_paranoid)
+/// or the CPU lacks an event, that event reads as zero and
+/// isAvailable() tells so; nothing is counted on other systems than Linux.
+/// Calls the counters could not be read for, or did not run during, are
+/// left out of the counts and only tallied as missed.
+/// Not thread safe, like the Profiler.
+class HardwareCounters {
+public:
+    using SystemId = std::size_t;
+
+    enum class Event {
+        Cycles,
+        Instructions,
+        /// Level 1 data cache read misses
+        L1Misses,
+        /// Last level cache misses
+        LLCMisses,
+        BranchMisses,
+        Count
+    };
+
+    static const std::size_t kEventCount = static_cast<std::size_t>(Event::Count);
+
+    struct Values {
+        std::array<std::uint64_t, kEventCount> counts{};
+
+        auto get(Event event) const -> std::uint64_t { return counts[static_cast<std::size_t>(event)]; }
+        /// Instructions per cycle
+        auto getIpc() const -> double;
+        auto operator+=(const Values& other) -> Values&;
+    };
+
+    struct Stats {
+        std::string name;
+        unsigned long calls{ 0 };
+        /// Calls left out of the counts
+        unsigned long missed{ 0 };
+        /// Frames the system ran in
+        unsigned long frames{ 0 };
+        /// Of the last frame, zero if it did not run then
+        Values lastFrame;
+        /// Since the last reset
+        Values total;
+
+        auto getPerFrame(Event event) const -> double;
+    };
+
+    static auto get() -> HardwareCounters&;
+    static auto getEventName(Event event) -> const char*;
+
+    HardwareCounters();
+    ~HardwareCounters();
+
+    HardwareCounters(const HardwareCounters&) = delete;
+    HardwareCounters& operator=(const HardwareCounters&) = delete;
+
+    /// Whether any event can be counted
+    bool isAvailable() const;
+    bool isAvailable(Event event) const;
+
+    /// Returns the same system for the same name
+    auto getSystem(const std::string& name) -> SystemId;
+
+    /// Counts nest, a system includes what it calls
+    void begin(SystemId system);
+    void end();
+    /// Frames nest, only the outermost one counts. Its counts are those
+    /// of the "frame" system.
+    void beginFrame();
+    void endFrame();
+
+    auto getStats(SystemId system) const -> Stats;
+    /// Of the systems that ran, in the order they were created
+    auto getStats() const -> std::vector<Stats>;
+    /// Per frame averages
+    void printStats(std::FILE* file = stdout) const;
+
+    void reset();
+
+private:
+    struct System {
+        Stats stats;
+        /// Summed up since the frame began
+        Values current;
+        unsigned long currentCalls{ 0 };
+        unsigned long currentMissed{ 0 };
+    };
+
+    /// Raw counts and times as read, only differences of them are scaled
+    struct Sample {
+        std::array<std::uint64_t, kEventCount> counts{};
+        std::uint64_t enabled{ 0 };
+        std::uint64_t running{ 0 };
+        bool valid{ false };
+    };
+
+    struct OpenSystem {
+        SystemId system;
+        Sample start;
+    };
+
+    void open();
+    /// Invalid when nothing could be opened or read, or nothing ran yet
+    auto read() -> Sample;
+    /// Scaled counts from start to end, false when either sample is
+    /// invalid or the counters did not run in between
+    static bool getDelta(const Sample& start, const Sample& end, Values& delta);
+    void commit(System& system);
+
+    std::vector<System> systems_;
+    std::unordered_map<std::string, SystemId> systemIds_;
+    std::vector<OpenSystem> open_;
+
+    SystemId frameSystem_;
+    unsigned int frameDepth_{ 0 };
+    Sample frameStart_;
+
+    /// File descriptors of the events, -1 if unavailable. The first one
+    /// open leads the group, all of them are read with one call.
+    std::array<int, kEventCount> fds_;
+    int leader_{ -1 };
+    /// Index in the group read of each available event
+    std::array<std::size_t, kEventCount> positions_{};
+    std::size_t openCount_{ 0 };
+};
+
+class HardwareCountersScope {
+public:
+    explicit HardwareCountersScope(HardwareCounters::SystemId system) { HardwareCounters::get().begin(system); }
+    ~HardwareCountersScope() { HardwareCounters::get().end(); }
+
+    HardwareCountersScope(const HardwareCountersScope&) = delete;
+    HardwareCountersScope& operator=(const HardwareCountersScope&) = delete;
+};
+
+class HardwareCountersFrameScope {
+public:
+    HardwareCountersFrameScope() { HardwareCounters::get().beginFrame(); }
+    ~HardwareCountersFrameScope() { HardwareCounters::get().endFrame(); }
+
+    HardwareCountersFrameScope(const HardwareCountersFrameScope&) = delete;
+    HardwareCountersFrameScope& operator=(const HardwareCountersFrameScope&) = delete;
+};
+} // namespace entitas
+
+#define ENTITAS_HARDWARE_CONCAT_(a, b) a##b
+#define ENTITAS_HARDWARE_CONCAT(a, b) ENTITAS_HARDWARE_CONCAT_(a, b)
+
+/// Counts the rest of the scope for a system id, the expression is not
+/// evaluated when disabled
+#define ENTITAS_HARDWARE_SCOPE(system) \
+    ::entitas::HardwareCountersScope ENTITAS_HARDWARE_CONCAT(entitasHardwareScope, __LINE__)(system)
+#define ENTITAS_HARDWARE_FRAME() \
+    ::entitas::HardwareCountersFrameScope ENTITAS_HARDWARE_CONCAT(entitasHardwareFrame, __LINE__)
+
+#else
+
+#define ENTITAS_HARDWARE_SCOPE(system)
+#define ENTITAS_HARDWARE_FRAME()
+
+#endif
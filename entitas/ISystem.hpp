@@ -5,7 +5,9 @@
 
 #pragma once
 
+#include "CommandBuffer.hpp"
 #include "Entity.hpp"
+#include "ExecutionBudget.hpp"
 #include "Matcher.hpp"
 #include "TriggerOnEvent.hpp"
 #include "Group.hpp"
@@ -13,6 +15,7 @@
 
 namespace entitas {
 class Context;
+class ThreadPool;
 
 class ISystem {
 protected:
@@ -98,6 +101,65 @@ public:
     std::vector<TriggerOnEvent> triggers;
 };
 
+/// Reactive system whose collected entities are split in chunks executed
+/// concurrently on a ThreadPool. Only a ReactiveSystem can execute
+/// it, create it through context.createSystem().
+///
+/// Inside executeChunk() the entities of the chunk may be read and their
+/// component fields written through get<T>(), nothing else of the context
+/// may be touched. Adding, replacing or removing components, creating and
+/// destroying entities and reporting in place modifications go through
+/// the command buffer of the chunk. The buffers are played back on the
+/// calling thread in chunk order once all chunks are done.
+class IParallelReactiveSystem : public IReactiveSystem {
+public:
+    virtual ~IParallelReactiveSystem() = default;
+
+    virtual void executeChunk(const EntityPtr* entities, std::size_t count, CommandBuffer& commands) = 0;
+
+    /// Most entities handed to one executeChunk() call
+    std::size_t chunkSize{ 1024 };
+    /// Pool running the chunks, the shared one when null
+    ThreadPool* threadPool{ nullptr };
+
+private:
+    void execute(Entities& entities) final
+    {
+        throw std::runtime_error("Error, parallel reactive systems can only be executed by a ReactiveSystem");
+    }
+};
+
+/// System spreading its work over several frames. Its container gives it
+/// a budget every frame, higher priorities first, and it resumes where it
+/// stopped on the next one, e.g. through a GroupCursor.
+class IBudgetedSystem {
+protected:
+    IBudgetedSystem() = default;
+
+public:
+    virtual ~IBudgetedSystem() = default;
+
+    virtual void execute(ExecutionBudget& budget) = 0;
+
+    /// Limits of one frame, on top of the budget left by the container
+    ExecutionLimits limits;
+    /// Higher runs first
+    int priority{ 0 };
+};
+
+/// Makes a reactive system budgeted. The collected entities wait in a
+/// backlog and are handed to execute(entities) in batches of batchSize,
+/// each entity consuming one item, as long as the budget lasts.
+class IBudgetedReactiveSystem {
+protected:
+    IBudgetedReactiveSystem() = default;
+
+public:
+    ExecutionLimits limits;
+    int priority{ 0 };
+    std::size_t batchSize{ 64 };
+};
+
 class IEnsureComponents {
 protected:
     IEnsureComponents() = default;
@@ -0,0 +1,146 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace entitas {
+template <typename, std::size_t Capacity = 4 * sizeof(void*)>
+class InlineFunction;
+
+/// Like std::function, but the callable is always stored inside the object
+/// so it never allocates. Callables bigger than 'Capacity' are rejected at
+/// compile time: capture less, or capture by pointer/reference.
+/// Calling an empty one throws std::bad_function_call, like std::function.
+template <typename TReturnType, typename... TArgs, std::size_t Capacity>
+class InlineFunction<TReturnType(TArgs...), Capacity> {
+    using Storage = typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type;
+
+    struct Operations {
+        TReturnType (*invoke)(void* callable, TArgs... args);
+        void (*copy)(void* destination, const void* source);
+        void (*move)(void* destination, void* source);
+        void (*destroy)(void* callable);
+    };
+
+    template <typename F>
+    struct OperationsFor {
+        static TReturnType invoke(void* callable, TArgs... args)
+        {
+            return (*static_cast<F*>(callable))(std::forward<TArgs>(args)...);
+        }
+        static void copy(void* destination, const void* source)
+        {
+            new (destination) F(*static_cast<const F*>(source));
+        }
+        static void move(void* destination, void* source)
+        {
+            new (destination) F(std::move(*static_cast<F*>(source)));
+        }
+        static void destroy(void* callable)
+        {
+            static_cast<F*>(callable)->~F();
+        }
+
+        static const Operations table;
+    };
+
+public:
+    InlineFunction() = default;
+    InlineFunction(std::nullptr_t) {}
+
+    template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, InlineFunction>::value>::type>
+    InlineFunction(F&& function)
+    {
+        using Callable = typename std::decay<F>::type;
+        static_assert(sizeof(Callable) <= Capacity, "Callable is too big for InlineFunction");
+        static_assert(alignof(Callable) <= alignof(Storage), "Callable is over-aligned for InlineFunction");
+        static_assert(std::is_nothrow_move_constructible<Callable>::value, "Callable must not throw when moved for InlineFunction");
+
+        new (&storage_) Callable(std::forward<F>(function));
+        operations_ = &OperationsFor<Callable>::table;
+    }
+
+    InlineFunction(const InlineFunction& other)
+    {
+        if (other.operations_) {
+            other.operations_->copy(&storage_, &other.storage_);
+            operations_ = other.operations_;
+        }
+    }
+
+    InlineFunction(InlineFunction&& other) noexcept
+    {
+        if (other.operations_) {
+            other.operations_->move(&storage_, &other.storage_);
+            operations_ = other.operations_;
+        }
+    }
+
+    ~InlineFunction() { reset(); }
+
+    InlineFunction& operator=(const InlineFunction& other)
+    {
+        if (this != &other) {
+            reset();
+            if (other.operations_) {
+                other.operations_->copy(&storage_, &other.storage_);
+                operations_ = other.operations_;
+            }
+        }
+        return *this;
+    }
+
+    InlineFunction& operator=(InlineFunction&& other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            if (other.operations_) {
+                other.operations_->move(&storage_, &other.storage_);
+                operations_ = other.operations_;
+            }
+        }
+        return *this;
+    }
+
+    InlineFunction& operator=(std::nullptr_t)
+    {
+        reset();
+        return *this;
+    }
+
+    inline TReturnType operator()(TArgs... args) const
+    {
+        if (operations_ == nullptr) {
+            throw std::bad_function_call();
+        }
+        return operations_->invoke(&storage_, std::forward<TArgs>(args)...);
+    }
+
+    explicit operator bool() const { return operations_ != nullptr; }
+
+private:
+    void reset()
+    {
+        if (operations_) {
+            operations_->destroy(&storage_);
+            operations_ = nullptr;
+        }
+    }
+
+    mutable Storage storage_;
+    const Operations* operations_{ nullptr };
+};
+
+template <typename TReturnType, typename... TArgs, std::size_t Capacity>
+template <typename F>
+const typename InlineFunction<TReturnType(TArgs...), Capacity>::Operations
+    InlineFunction<TReturnType(TArgs...), Capacity>::OperationsFor<F>::table
+    = { &OperationsFor<F>::invoke, &OperationsFor<F>::copy, &OperationsFor<F>::move, &OperationsFor<F>::destroy };
+}
@@ -5,6 +5,7 @@
 #include "Matcher.hpp"
 #include "TriggerOnEvent.hpp"
 #include <algorithm>
+#include <string>
 
 namespace entitas {
 Matcher Matcher::allOf(const ComponentIdList indices)
@@ -56,6 +57,7 @@ bool Matcher::isEmpty() const
 
 bool Matcher::matches(const EntityPtr& entity)
 {
+    ENTITAS_COUNT(MatcherEvaluations);
     auto matchesAllOf = indicesAllOf_.empty() || entity->hasComponents(indicesAllOf_);
     auto matchesAnyOf = indicesAnyOf_.empty() || entity->hasAnyComponent(indicesAnyOf_);
     auto matchesNoneOf = indicesNoneOf_.empty() || !entity->hasAnyComponent(indicesNoneOf_);
@@ -87,6 +89,24 @@ auto Matcher::getNoneOfIndices() const -> const ComponentIdList
     return indicesNoneOf_;
 }
 
+auto Matcher::toString() const -> std::string
+{
+    auto format = [](const char* name, const ComponentIdList& indices) -> std::string {
+        if (indices.empty()) {
+            return "";
+        }
+
+        std::string text = name;
+        text += "(";
+        for (std::size_t i = 0; i < indices.size(); ++i) {
+            text += (i > 0 ? "," : "") + std::to_string(indices[i]);
+        }
+        return text + ")";
+    };
+
+    return format("allOf", indicesAllOf_) + format("anyOf", indicesAnyOf_) + format("noneOf", indicesNoneOf_);
+}
+
 auto Matcher::getHashCode() const -> unsigned int
 {
     return hashCached_;
@@ -129,6 +149,11 @@ auto Matcher::onEntityAddedOrRemoved() -> const TriggerOnEvent
     return TriggerOnEvent(*this, GroupEventType::AddedOrRemoved);
 }
 
+auto Matcher::onEntityUpdated() -> const TriggerOnEvent
+{
+    return TriggerOnEvent(*this, GroupEventType::Updated);
+}
+
 bool Matcher::operator==(const Matcher right) const
 {
     return this->getHashCode() == right.getHashCode() && this->compareIndices(right);
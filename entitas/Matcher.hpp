@@ -30,6 +30,8 @@ namespace entitas
         auto getAllOfIndices() const -> const ComponentIdList;
         auto getAnyOfIndices() const -> const ComponentIdList;
         auto getNoneOfIndices() const -> const ComponentIdList;
+        /// Like "allOf(1,2)noneOf(3)", for diagnostics
+        auto toString() const -> std::string;
 
         auto getHashCode() const -> unsigned int;
         bool compareIndices(const Matcher& matcher) const;
@@ -37,6 +39,7 @@ namespace entitas
         auto onEntityAdded() -> const TriggerOnEvent;
         auto onEntityRemoved() -> const TriggerOnEvent;
         auto onEntityAddedOrRemoved() -> const TriggerOnEvent;
+        auto onEntityUpdated() -> const TriggerOnEvent;
 
         bool operator ==(const Matcher right) const;
 
@@ -0,0 +1,42 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#include "MemoryReport.hpp"
+
+namespace entitas {
+void MemoryReport::print(std::FILE* file) const
+{
+    std::fprintf(file, "%u entities in %u slots\n", entityCount, entitySlots);
+
+    std::fprintf(file, "%-4s %-32s %8s %10s %12s %10s %12s\n", "id", "component", "size", "live", "live bytes", "pooled", "pooled bytes");
+    for (const auto& c : components) {
+        std::fprintf(file, "%-4u %-32s %8zu %10zu %12zu %10zu %12zu\n",
+            c.index, c.name, c.size, c.liveCount, c.getLiveBytes(), c.pooledCount, c.getPooledBytes());
+    }
+
+    std::fprintf(file, "%-40s %10s %12s %12s %12s\n", "group", "entities", "members", "cache", "changes");
+    for (const auto& g : groups) {
+        std::fprintf(file, "%-40s %10zu %12zu %12zu %12zu\n", g.matcher.toString().c_str(), g.entityCount, g.memberBytes, g.cacheBytes, g.changeBytes);
+    }
+
+    std::fprintf(file, "%-12s %12s %12s\n", "bytes", "current", "peak");
+    const struct {
+        const char* name;
+        std::size_t current;
+        std::size_t peak;
+    } rows[] = {
+        { "components", current.components, peak.components },
+        { "groups", current.groups, peak.groups },
+        { "entities", current.entities, peak.entities },
+        { "collectors", current.collectors, peak.collectors },
+        { "delegates", current.delegates, peak.delegates },
+        { "context", current.context, peak.context },
+        { "total", current.getTotal(), peakTotal },
+    };
+    for (const auto& row : rows) {
+        std::fprintf(file, "%-12s %12zu %12zu\n", row.name, row.current, row.peak);
+    }
+    std::fprintf(file, "%-12s %12zu %12zu  (all contexts, counted)\n", "node pools", nodePoolBytes, nodePoolPeakBytes);
+}
+} // namespace entitas
@@ -0,0 +1,116 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "ComponentTypeId.hpp"
+#include "Matcher.hpp"
+#include "PoolAllocator.hpp"
+#include <cstdio>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace entitas {
+
+/// Memory held by a context, see Context::getMemoryReport().
+/// Containers are counted by capacity with the node layout of the common
+/// standard libraries, so bytes by category are close estimates rather
+/// than what the allocator handed out, and their peaks only cover the
+/// reports taken. The node pool figures are exact, see PoolAllocator.hpp.
+struct MemoryReport {
+    struct ComponentUsage {
+        ComponentId index;
+        const char* name;
+        /// sizeof() of the type
+        std::size_t size;
+        /// On enabled entities
+        std::size_t liveCount;
+        /// Idle in the ComponentPools
+        std::size_t pooledCount;
+
+        auto getLiveBytes() const -> std::size_t { return liveCount * size; }
+        auto getPooledBytes() const -> std::size_t { return pooledCount * size; }
+    };
+
+    struct GroupUsage {
+        Matcher matcher;
+        std::size_t entityCount;
+        /// The member set
+        std::size_t memberBytes;
+        /// The entity list handed out by getEntities()
+        std::size_t cacheBytes;
+        /// Changes recorded for the batched events
+        std::size_t changeBytes;
+    };
+
+    /// Bytes by category
+    struct Totals {
+        /// Live and pooled components
+        std::size_t components{ 0 };
+        std::size_t groups{ 0 };
+        /// Entity slab and what the entities allocate beside components
+        std::size_t entities{ 0 };
+        /// Shared collectors of the context
+        std::size_t collectors{ 0 };
+        /// Handlers of the context, group and entity events
+        std::size_t delegates{ 0 };
+        /// Buffers of the context itself
+        std::size_t context{ 0 };
+
+        auto getTotal() const -> std::size_t
+        {
+            return components + groups + entities + collectors + delegates + context;
+        }
+    };
+
+    /// Component types without data are left out, they take no memory
+    std::vector<ComponentUsage> components;
+    std::vector<GroupUsage> groups;
+    unsigned int entityCount{ 0 };
+    /// Slots ever used, live or reusable
+    unsigned int entitySlots{ 0 };
+    Totals current;
+    /// Highest value of each category over the reports of the context
+    Totals peak;
+    /// Highest total, the categories might have peaked at different times
+    std::size_t peakTotal{ 0 };
+    /// Counted by the node pool allocators of all contexts and threads,
+    /// part of the categories above. The peak is the highest ever, not
+    /// only of the reports.
+    std::size_t nodePoolBytes{ 0 };
+    std::size_t nodePoolPeakBytes{ 0 };
+
+    void print(std::FILE* file = stdout) const;
+};
+
+namespace memory {
+    template <typename T>
+    auto getHeapBytes(const std::vector<T>& container) -> std::size_t
+    {
+        return container.capacity() * sizeof(T);
+    }
+
+    template <typename T, typename... TArgs>
+    auto getHeapBytes(const std::unordered_set<T, TArgs...>& container) -> std::size_t
+    {
+        // Buckets, and per node a next pointer and the value
+        return container.bucket_count() * sizeof(void*) + container.size() * (sizeof(void*) + sizeof(T));
+    }
+
+    template <typename K, typename V, typename... TArgs>
+    auto getHeapBytes(const std::unordered_map<K, V, TArgs...>& container) -> std::size_t
+    {
+        return container.bucket_count() * sizeof(void*) + container.size() * (sizeof(void*) + sizeof(std::pair<const K, V>));
+    }
+
+    template <typename K, typename V, typename... TArgs>
+    auto getHeapBytes(const std::map<K, V, TArgs...>& container) -> std::size_t
+    {
+        // Color, parent, left and right per node
+        return container.size() * (4 * sizeof(void*) + sizeof(std::pair<const K, V>));
+    }
+} // namespace memory
+} // namespace entitas
@@ -0,0 +1,185 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace entitas {
+
+namespace detail {
+    /// Bytes the node pools got from the system and did not give back yet,
+    /// in use or idle in a free list. Only counted when memory actually
+    /// comes from or goes back to the system, recycling nodes costs nothing.
+    class NodePoolBytes {
+    public:
+        static auto get() -> NodePoolBytes&
+        {
+            // Trivially destructible, so usable by exiting threads
+            static NodePoolBytes bytes;
+            return bytes;
+        }
+
+        void add(std::size_t bytes)
+        {
+            auto current = current_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+            auto peak = peak_.load(std::memory_order_relaxed);
+            while (peak < current && !peak_.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+            }
+        }
+
+        void remove(std::size_t bytes)
+        {
+            current_.fetch_sub(bytes, std::memory_order_relaxed);
+        }
+
+        auto getCurrent() const -> std::size_t { return current_.load(std::memory_order_relaxed); }
+        auto getPeak() const -> std::size_t { return peak_.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<std::size_t> current_{ 0 };
+        std::atomic<std::size_t> peak_{ 0 };
+    };
+
+    /// Blocks of one size released on this thread, linked through their
+    /// first bytes. Released back to the system when the thread exits.
+    template <std::size_t Size>
+    class NodeFreeList {
+    public:
+        static auto allocate() -> void*
+        {
+            auto& head = getHead();
+            if (head != getClosed()) {
+                touchGuard();
+                if (head != nullptr) {
+                    auto block = head;
+                    head = *static_cast<void**>(block);
+                    return block;
+                }
+            }
+
+            NodePoolBytes::get().add(Size);
+            return ::operator new(Size);
+        }
+
+        static void deallocate(void* block)
+        {
+            auto& head = getHead();
+            if (head == getClosed()) {
+                NodePoolBytes::get().remove(Size);
+                ::operator delete(block);
+                return;
+            }
+
+            touchGuard();
+            *static_cast<void**>(block) = head;
+            head = block;
+        }
+
+    private:
+        /// Trivial, so still usable while the other thread locals of an
+        /// exiting thread are destroyed
+        static auto getHead() -> void*&
+        {
+            static thread_local void* head = nullptr;
+            return head;
+        }
+
+        /// Set once the list has been released
+        static auto getClosed() -> void*
+        {
+            static char closed;
+            return &closed;
+        }
+
+        struct Guard {
+            ~Guard()
+            {
+                auto& head = getHead();
+                while (head != nullptr) {
+                    auto next = *static_cast<void**>(head);
+                    NodePoolBytes::get().remove(Size);
+                    ::operator delete(head);
+                    head = next;
+                }
+                head = getClosed();
+            }
+        };
+
+        static void touchGuard()
+        {
+            static thread_local Guard guard;
+            (void)guard;
+        }
+    };
+} // namespace detail
+
+/// Allocator for node based containers. Single nodes are recycled through
+/// a per-thread free list of their size instead of going back to the
+/// system, so a container that keeps about the same number of elements
+/// stops allocating once warmed up. Bucket arrays and other multi-element
+/// allocations go straight to operator new.
+/// Nodes freed on another thread than the one that allocated them are
+/// simply recycled there.
+template <typename T>
+class NodePoolAllocator {
+public:
+    using value_type = T;
+
+    NodePoolAllocator() = default;
+    template <typename U>
+    NodePoolAllocator(const NodePoolAllocator<U>&) {}
+
+    auto allocate(std::size_t n) -> T*
+    {
+        if (n == 1) {
+            return static_cast<T*>(FreeList::allocate());
+        }
+        detail::NodePoolBytes::get().add(n * sizeof(T));
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n)
+    {
+        if (n == 1) {
+            FreeList::deallocate(p);
+        } else {
+            detail::NodePoolBytes::get().remove(n * sizeof(T));
+            ::operator delete(p);
+        }
+    }
+
+    template <typename U>
+    bool operator==(const NodePoolAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const NodePoolAllocator<U>&) const { return false; }
+
+private:
+    using FreeList = detail::NodeFreeList<(sizeof(T) < sizeof(void*) ? sizeof(void*) : sizeof(T))>;
+};
+
+/// Bytes held by the NodePoolAllocators of all threads, in use or idle
+/// in the free lists. Counted by the allocators, so exact.
+inline auto getNodePoolBytes() -> std::size_t
+{
+    return detail::NodePoolBytes::get().getCurrent();
+}
+
+/// Highest getNodePoolBytes() ever got, whenever that was
+inline auto getNodePoolPeakBytes() -> std::size_t
+{
+    return detail::NodePoolBytes::get().getPeak();
+}
+
+template <typename T, typename THash = std::hash<T>>
+using PooledSet = std::unordered_set<T, THash, std::equal_to<T>, NodePoolAllocator<T>>;
+
+template <typename K, typename V, typename THash = std::hash<K>>
+using PooledMap = std::unordered_map<K, V, THash, std::equal_to<K>, NodePoolAllocator<std::pair<const K, V>>>;
+} // namespace entitas
@@ -0,0 +1,238 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#include "Profiler.hpp"
+#include "TypeName.hpp"
+
+#ifdef ENTITAS_PROFILE
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace entitas {
+namespace {
+auto getMicroseconds(Profiler::Clock::duration duration) -> double
+{
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+void writeJsonString(std::FILE* file, const std::string& value)
+{
+    std::fputc('"', file);
+    for (auto c : value) {
+        if (c == '"' || c == '\\') {
+            std::fputc('\\', file);
+        }
+        std::fputc(c, file);
+    }
+    std::fputc('"', file);
+}
+}
+
+auto Profiler::get() -> Profiler&
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+auto Profiler::getTypeName(const std::type_info& type) -> std::string
+{
+    return entitas::getTypeName(type);
+}
+
+Profiler::Profiler()
+    : origin_{ Clock::now() }
+{
+    frameSection_ = getSection("frame");
+}
+
+auto Profiler::getSection(const std::string& name) -> SectionId
+{
+    auto it = sectionIds_.find(name);
+    if (it != sectionIds_.end()) {
+        return it->second;
+    }
+
+    auto section = sections_.size();
+    sections_.emplace_back();
+    sections_.back().name = name;
+    sectionIds_.emplace(name, section);
+    return section;
+}
+
+auto Profiler::getSectionName(SectionId section) const -> const std::string&
+{
+    return sections_.at(section).name;
+}
+
+void Profiler::begin(SectionId section)
+{
+    open_.push_back(OpenSection{ section, Clock::now() });
+}
+
+void Profiler::end()
+{
+    auto now = Clock::now();
+    if (open_.empty()) {
+        throw std::runtime_error("Error, profiler section ended but none was begun");
+    }
+
+    auto open = open_.back();
+    open_.pop_back();
+    record(open.section, open.start, now);
+}
+
+void Profiler::beginFrame()
+{
+    if (frameDepth_++ == 0) {
+        frameStart_ = Clock::now();
+    }
+}
+
+void Profiler::endFrame()
+{
+    if (frameDepth_ == 0 || --frameDepth_ > 0) {
+        return;
+    }
+
+    record(frameSection_, frameStart_, Clock::now());
+    if (traceFrameCount_ == 0) {
+        return;
+    }
+
+    // Recycles the events of the oldest frame
+    std::vector<Event> events;
+    if (frames_.size() >= traceFrameCount_) {
+        events = std::move(frames_.front());
+        frames_.pop_front();
+        events.clear();
+    }
+
+    frames_.push_back(std::move(events_));
+    events_ = std::move(events);
+}
+
+void Profiler::record(SectionId section, Clock::time_point start, Clock::time_point end)
+{
+    auto& s = sections_[section];
+    auto duration = getMicroseconds(end - start);
+    if (s.window.size() < windowSize_) {
+        s.window.push_back(duration);
+    } else {
+        s.window[s.next] = duration;
+    }
+    s.next = (s.next + 1) % windowSize_;
+    ++s.calls;
+
+    if (traceFrameCount_ > 0) {
+        events_.push_back(Event{ section, start, end - start });
+    }
+}
+
+void Profiler::setWindowSize(std::size_t sampleCount)
+{
+    windowSize_ = std::max<std::size_t>(sampleCount, 1);
+    for (auto& section : sections_) {
+        section.window.clear();
+        section.next = 0;
+    }
+}
+
+auto Profiler::getStats(SectionId section) const -> Stats
+{
+    const auto& s = sections_.at(section);
+    Stats stats;
+    stats.name = s.name;
+    stats.samples = s.window.size();
+    stats.calls = s.calls;
+    if (s.window.empty()) {
+        return stats;
+    }
+
+    auto sorted = s.window;
+    std::sort(sorted.begin(), sorted.end());
+    stats.min = sorted.front();
+    for (auto sample : sorted) {
+        stats.avg += sample;
+    }
+    stats.avg /= sorted.size();
+    stats.p99 = sorted[static_cast<std::size_t>(0.99 * (sorted.size() - 1) + 0.5)];
+
+    return stats;
+}
+
+auto Profiler::getStats() const -> std::vector<Stats>
+{
+    std::vector<Stats> stats;
+    for (SectionId section = 0; section < sections_.size(); ++section) {
+        if (!sections_[section].window.empty()) {
+            stats.push_back(getStats(section));
+        }
+    }
+
+    return stats;
+}
+
+void Profiler::printStats(std::FILE* file) const
+{
+    std::fprintf(file, "%-40s %10s %10s %10s %10s   (us)\n", "", "calls", "min", "avg", "p99");
+    for (const auto& stats : getStats()) {
+        std::fprintf(file, "%-40s %10lu %10.1f %10.1f %10.1f\n", stats.name.c_str(), stats.calls, stats.min, stats.avg, stats.p99);
+    }
+}
+
+void Profiler::setTraceFrameCount(std::size_t frameCount)
+{
+    traceFrameCount_ = frameCount;
+    while (frames_.size() > traceFrameCount_) {
+        frames_.pop_front();
+    }
+
+    if (traceFrameCount_ == 0) {
+        events_.clear();
+    }
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) const
+{
+    auto file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+
+    writeChromeTrace(file);
+    return std::fclose(file) == 0;
+}
+
+void Profiler::writeChromeTrace(std::FILE* file) const
+{
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    auto first = true;
+    for (const auto& events : frames_) {
+        for (const auto& event : events) {
+            std::fprintf(file, "%s\n{\"name\":", first ? "" : ",");
+            writeJsonString(file, sections_[event.section].name);
+            std::fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}",
+                event.section == frameSection_ ? "frame" : "system",
+                getMicroseconds(event.start - origin_), getMicroseconds(event.duration));
+            first = false;
+        }
+    }
+    std::fprintf(file, "\n]}\n");
+}
+
+void Profiler::reset()
+{
+    for (auto& section : sections_) {
+        section.window.clear();
+        section.next = 0;
+        section.calls = 0;
+    }
+
+    events_.clear();
+    frames_.clear();
+}
+} // namespace entitas
+
+#endif
@@ -0,0 +1,160 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#pragma once
+
+// Per-system timing. Only compiled in when ENTITAS_PROFILE is defined,
+// otherwise the macros at the end expand to nothing and SystemContainer
+// carries no profiling state.
+
+#ifdef ENTITAS_PROFILE
+
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+namespace entitas {
+
+/// Times named sections: the calls SystemContainer makes into its systems,
+/// the subsystems of reactive systems and whatever else is wrapped in
+/// ENTITAS_PROFILE_SCOPE. Keeps rolling statistics per section and,
+/// optionally, the sections of the last frames for a Chrome trace.
+/// Not thread safe, sections are entered and left on the thread executing
+/// the systems.
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+    using SectionId = std::size_t;
+
+    /// Over the samples in the window of a section, in microseconds
+    struct Stats {
+        std::string name;
+        std::size_t samples{ 0 };
+        /// Since the last reset, not limited to the window
+        unsigned long calls{ 0 };
+        double min{ 0.0 };
+        double avg{ 0.0 };
+        double p99{ 0.0 };
+    };
+
+    static auto get() -> Profiler&;
+    /// Demangled when the compiler allows it
+    static auto getTypeName(const std::type_info& type) -> std::string;
+
+    Profiler();
+
+    /// Returns the same section for the same name
+    auto getSection(const std::string& name) -> SectionId;
+    auto getSectionName(SectionId section) const -> const std::string&;
+
+    void begin(SectionId section);
+    /// Ends the section begun last
+    void end();
+    /// Frames nest, only the outermost one counts. Its duration is
+    /// sampled in the "frame" section.
+    void beginFrame();
+    void endFrame();
+
+    /// Samples kept per section for the statistics, 256 by default
+    void setWindowSize(std::size_t sampleCount);
+    auto getStats(SectionId section) const -> Stats;
+    /// Of the sections that have been sampled, in the order they were created
+    auto getStats() const -> std::vector<Stats>;
+    void printStats(std::FILE* file = stdout) const;
+
+    /// Keeps the sections of the last 'frameCount' frames for
+    /// writeChromeTrace(), none by default. Sections timed between two
+    /// frames are kept with the next one.
+    void setTraceFrameCount(std::size_t frameCount);
+    /// Writes the kept frames in the Chrome trace event format, which
+    /// chrome://tracing and Perfetto open
+    bool writeChromeTrace(const std::string& path) const;
+    void writeChromeTrace(std::FILE* file) const;
+
+    /// Drops the samples and the kept frames, sections stay valid
+    void reset();
+
+private:
+    struct Section {
+        std::string name;
+        /// Ring of the last samples, in microseconds
+        std::vector<double> window;
+        std::size_t next{ 0 };
+        unsigned long calls{ 0 };
+    };
+
+    struct Event {
+        SectionId section;
+        Clock::time_point start;
+        Clock::duration duration;
+    };
+
+    struct OpenSection {
+        SectionId section;
+        Clock::time_point start;
+    };
+
+    void record(SectionId section, Clock::time_point start, Clock::time_point end);
+
+    std::vector<Section> sections_;
+    std::unordered_map<std::string, SectionId> sectionIds_;
+    std::vector<OpenSection> open_;
+    std::size_t windowSize_{ 256 };
+
+    SectionId frameSection_;
+    unsigned int frameDepth_{ 0 };
+    Clock::time_point frameStart_;
+
+    std::size_t traceFrameCount_{ 0 };
+    /// Events of the frame in progress
+    std::vector<Event> events_;
+    std::deque<std::vector<Event>> frames_;
+    /// Trace timestamps are relative to it
+    Clock::time_point origin_;
+};
+
+/// Times the enclosing scope as a section
+class ProfileScope {
+public:
+    explicit ProfileScope(Profiler::SectionId section) { Profiler::get().begin(section); }
+    ~ProfileScope() { Profiler::get().end(); }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+class ProfileFrameScope {
+public:
+    ProfileFrameScope() { Profiler::get().beginFrame(); }
+    ~ProfileFrameScope() { Profiler::get().endFrame(); }
+
+    ProfileFrameScope(const ProfileFrameScope&) = delete;
+    ProfileFrameScope& operator=(const ProfileFrameScope&) = delete;
+};
+} // namespace entitas
+
+#define ENTITAS_PROFILE_CONCAT_(a, b) a##b
+#define ENTITAS_PROFILE_CONCAT(a, b) ENTITAS_PROFILE_CONCAT_(a, b)
+
+/// Times the rest of the scope under a section of that name
+#define ENTITAS_PROFILE_SCOPE(name)                                                                                          \
+    static const auto ENTITAS_PROFILE_CONCAT(entitasProfileSection, __LINE__) = ::entitas::Profiler::get().getSection(name); \
+    ::entitas::ProfileScope ENTITAS_PROFILE_CONCAT(entitasProfileScope, __LINE__)(ENTITAS_PROFILE_CONCAT(entitasProfileSection, __LINE__))
+/// Same with a section id, the expression is not evaluated when disabled
+#define ENTITAS_PROFILE_SECTION_SCOPE(section) \
+    ::entitas::ProfileScope ENTITAS_PROFILE_CONCAT(entitasProfileScope, __LINE__)(section)
+#define ENTITAS_PROFILE_FRAME() \
+    ::entitas::ProfileFrameScope ENTITAS_PROFILE_CONCAT(entitasProfileFrame, __LINE__)
+
+#else
+
+#define ENTITAS_PROFILE_SCOPE(name)
+#define ENTITAS_PROFILE_SECTION_SCOPE(section)
+#define ENTITAS_PROFILE_FRAME()
+
+#endif
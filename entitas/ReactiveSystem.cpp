@@ -4,7 +4,10 @@
 
 #include "ReactiveSystem.hpp"
 #include "Context.hpp"
+#include "ThreadPool.hpp"
 #include "TriggerOnEvent.hpp"
+#include "TypeName.hpp"
+#include <algorithm>
 
 namespace entitas {
 ReactiveSystem::ReactiveSystem(Context* context, std::shared_ptr<IReactiveSystem> subsystem)
@@ -18,9 +21,12 @@ ReactiveSystem::ReactiveSystem(Context* context, std::shared_ptr<IMultiReactiveS
 }
 
 ReactiveSystem::ReactiveSystem(Context* context, std::shared_ptr<IReactiveExecuteSystem> subsystem, std::vector<TriggerOnEvent> triggers)
-    : subsystem_{ subsystem }
+    : context_{ context }
+    , subsystem_{ subsystem }
 {
     using std::dynamic_pointer_cast;
+    parallelSubsystem_ = dynamic_pointer_cast<IParallelReactiveSystem>(subsystem);
+
     if (auto subsystemEnsure = dynamic_pointer_cast<IEnsureComponents>(subsystem)) {
         ensureComponents_ = subsystemEnsure->ensureComponents;
     }
@@ -34,32 +40,27 @@ ReactiveSystem::ReactiveSystem(Context* context, std::shared_ptr<IReactiveExecut
         clearAfterExecute_ = true;
     }
 
-    auto triggersLength = triggers.size();
-    //auto groups = std::vector<Group::SharedPtr>(triggersLength);
-    auto groups = std::vector<Group::WeakPtr>(triggersLength);
-    auto eventTypes = std::vector<GroupEventType>(triggersLength);
-
-    for (unsigned int i = 0; i < triggersLength; ++i) {
-        auto trigger = triggers[i];
-        groups[i] = context->getGroup(trigger.trigger);
-        eventTypes[i] = trigger.eventType;
+    if (auto subsystemBudgeted = dynamic_pointer_cast<IBudgetedReactiveSystem>(subsystem)) {
+        budgeted_ = true;
+        limits = subsystemBudgeted->limits;
+        priority = subsystemBudgeted->priority;
+        batchSize_ = std::max<std::size_t>(subsystemBudgeted->batchSize, 1);
     }
 
-#if 0
-    for_each(triggers, [&](auto& trigger)
-             {
-                 groups.push_back(context->getGroup(trigger));
-                 eventTypes.push_back(trigger.eventType);
-             });
-#endif
+    collector_ = context->getSharedCollector(triggers);
+    consumer_ = collector_->addConsumer();
 
-    collector_ = new Collector(std::move(groups), std::move(eventTypes));
+#ifdef ENTITAS_PROFILE
+    section_ = Profiler::get().getSection(getTypeName(typeid(*subsystem)) + ".entities");
+#endif
+#ifdef ENTITAS_FLIGHT_RECORDER
+    recorderName_ = FlightRecorder::getName(getTypeName(typeid(*subsystem)) + ".entities");
+#endif
 }
 
 ReactiveSystem::~ReactiveSystem()
 {
-    deactivate();
-    delete collector_;
+    collector_->removeConsumer(consumer_);
 }
 
 auto ReactiveSystem::getSubsystem() const -> std::shared_ptr<IReactiveExecuteSystem>
@@ -69,59 +70,133 @@ auto ReactiveSystem::getSubsystem() const -> std::shared_ptr<IReactiveExecuteSys
 
 void ReactiveSystem::activate()
 {
-    collector_->activate();
+    collector_->activateConsumer(consumer_);
 }
 
 void ReactiveSystem::deactivate()
 {
-    collector_->deactivate();
+    collector_->deactivateConsumer(consumer_);
+    clearBacklog();
 }
 
 void ReactiveSystem::clear()
 {
-    collector_->clearCollectedEntities();
+    collector_->clearCollectedEntities(consumer_);
+    clearBacklog();
 }
 
 void ReactiveSystem::execute()
 {
-    if (collector_->getCollectedEntities().size() != 0) {
-        if (!ensureComponents_.isEmpty()) {
-            if (!excludeComponents_.isEmpty()) {
-                for (const auto& e : collector_->getCollectedEntities()) {
-                    if (ensureComponents_.matches(e) && !excludeComponents_.matches(e)) {
-                        entityBuffer_.push_back(e);
-                    }
-                }
-            } else {
-                for (const auto& e : collector_->getCollectedEntities()) {
-                    if (ensureComponents_.matches(e)) {
-                        entityBuffer_.push_back(e);
-                    }
-                }
-            }
-        } else if (!excludeComponents_.isEmpty()) {
-            for (const auto& e : collector_->getCollectedEntities()) {
-                if (!excludeComponents_.matches(e)) {
-                    entityBuffer_.push_back(e);
-                }
-            }
-        } else {
-            for (const auto& e : collector_->getCollectedEntities()) {
-                entityBuffer_.push_back(e);
-            }
+    if (!backlog_.empty()) {
+        auto budget = ExecutionBudget();
+        execute(budget);
+        return;
+    }
+
+    collector_->readCollectedEntities(consumer_, entityBuffer_);
+    executeBuffer();
+}
+
+void ReactiveSystem::execute(ExecutionBudget& budget)
+{
+    // Entities still waiting in the backlog keep their place
+    collector_->readCollectedEntities(consumer_, entityBuffer_);
+    for (auto& entity : entityBuffer_) {
+        if (pendingEntities_.insert(entity.get()).second) {
+            backlog_.push_back(std::move(entity));
+        }
+    }
+    entityBuffer_.clear();
+
+    auto batchSize = budgeted_ ? batchSize_ : backlog_.size();
+    while (backlogPosition_ < backlog_.size() && !budget.isExhausted()) {
+        auto count = std::min({ batchSize, budget.getRemainingItems(), backlog_.size() - backlogPosition_ });
+        for (auto i = backlogPosition_, end = backlogPosition_ + count; i < end; ++i) {
+            pendingEntities_.erase(backlog_[i].get());
+            entityBuffer_.push_back(std::move(backlog_[i]));
         }
 
-        collector_->clearCollectedEntities();
-        
-        if (!entityBuffer_.empty()) {
+        backlogPosition_ += count;
+        budget.consume(count);
+        executeBuffer();
+    }
+
+    if (backlogPosition_ == backlog_.size()) {
+        backlog_.clear();
+        backlogPosition_ = 0;
+    } else if (backlogPosition_ * 2 >= backlog_.size()) {
+        backlog_.erase(backlog_.begin(), backlog_.begin() + backlogPosition_);
+        backlogPosition_ = 0;
+    }
+}
+
+bool ReactiveSystem::isBudgeted() const
+{
+    return budgeted_;
+}
+
+void ReactiveSystem::executeBuffer()
+{
+    if (!ensureComponents_.isEmpty() || !excludeComponents_.isEmpty()) {
+        entityBuffer_.erase(std::remove_if(entityBuffer_.begin(), entityBuffer_.end(),
+                                [this](const EntityPtr& e) {
+                                    return (!ensureComponents_.isEmpty() && !ensureComponents_.matches(e))
+                                        || (!excludeComponents_.isEmpty() && excludeComponents_.matches(e));
+                                }),
+            entityBuffer_.end());
+    }
+
+    if (!entityBuffer_.empty()) {
+        ENTITAS_PROFILE_SECTION_SCOPE(section_);
+        ENTITAS_RECORD_COUNT(recorderName_, entityBuffer_.size());
+        if (parallelSubsystem_) {
+            executeParallel();
+        } else {
             subsystem_->execute(entityBuffer_);
-            entityBuffer_.clear();
+        }
+        entityBuffer_.clear();
 
-            // FIXME we are already clearing?!
-            if (clearAfterExecute_) {
-                collector_->clearCollectedEntities();
-            }
+        // Drop what got collected while executing
+        if (clearAfterExecute_) {
+            collector_->clearCollectedEntities(consumer_);
         }
     }
 }
+
+void ReactiveSystem::executeParallel()
+{
+    auto count = entityBuffer_.size();
+    auto chunkSize = std::max<std::size_t>(parallelSubsystem_->chunkSize, 1);
+    auto chunks = (count + chunkSize - 1) / chunkSize;
+    if (commandBuffers_.size() < chunks) {
+        commandBuffers_.resize(chunks);
+    }
+
+    const EntityPtr* entities = entityBuffer_.data();
+    try {
+        auto& pool = parallelSubsystem_->threadPool ? *parallelSubsystem_->threadPool : ThreadPool::getShared();
+        pool.parallelFor(chunks, [&](std::size_t chunk) {
+            auto begin = chunk * chunkSize;
+            parallelSubsystem_->executeChunk(entities + begin, std::min(chunkSize, count - begin), commandBuffers_[chunk]);
+        });
+    } catch (...) {
+        // Nothing of a failed execution gets applied
+        for (auto& commands : commandBuffers_) {
+            commands.clear();
+        }
+        entityBuffer_.clear();
+        throw;
+    }
+
+    for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+        commandBuffers_[chunk].playback(context_);
+    }
+}
+
+void ReactiveSystem::clearBacklog()
+{
+    backlog_.clear();
+    backlogPosition_ = 0;
+    pendingEntities_.clear();
+}
 }
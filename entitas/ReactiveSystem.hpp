@@ -4,11 +4,13 @@
 
 #pragma once
 
-#include "Collector.hpp"
+#include "FlightRecorder.hpp"
 #include "ISystem.hpp"
+#include "Profiler.hpp"
+#include "SharedCollector.hpp"
 
 namespace entitas {
-class ReactiveSystem : public IExecuteSystem {
+class ReactiveSystem : public IExecuteSystem, public IBudgetedSystem {
 public:
     ReactiveSystem(Context* context, std::shared_ptr<IReactiveSystem> subsystem);
     ReactiveSystem(Context* context, std::shared_ptr<IMultiReactiveSystem> subsystem);
@@ -17,7 +19,7 @@ public:
 
     auto getSubsystem() const -> std::shared_ptr<IReactiveExecuteSystem>;
     /// Activates the ReactiveSystem and starts observing changes
-    /// based on the specified Collector.
+    /// based on the shared collector of its triggers.
     /// ReactiveSystem are activated by default.
     void activate();
     /// Deactivates the ReactiveSystem.
@@ -29,11 +31,27 @@ public:
     void clear();
     /// Will call execute(entities) with changed entities
     /// if there are any. Otherwise it will not call execute(entities).
-    void execute();
+    /// Parallel subsystems get them through executeChunk() instead.
+    void execute() override;
+    /// Executes the backlog and the changed entities in batches until the
+    /// budget is exhausted, the rest waits for the next call.
+    void execute(ExecutionBudget& budget) override;
+    /// True when the subsystem is an IBudgetedReactiveSystem
+    bool isBudgeted() const;
 
 private:
+    /// Filters entityBuffer_ and executes the subsystem with it
+    void executeBuffer();
+    void executeParallel();
+    void clearBacklog();
+
+    Context* context_;
     std::shared_ptr<IReactiveExecuteSystem> subsystem_;
-    Collector* collector_{ nullptr };
+    /// Same as subsystem_ when it executes in chunks
+    std::shared_ptr<IParallelReactiveSystem> parallelSubsystem_;
+    /// Shared with the other reactive systems that have the same triggers
+    std::shared_ptr<SharedCollector> collector_;
+    SharedCollector::ConsumerId consumer_;
     /// Additional matchers
     /// ensure that only these components are gathered by observer
     Matcher ensureComponents_;
@@ -42,5 +60,22 @@ private:
     /// FIXME bug?
     bool clearAfterExecute_{ false };
     Entities entityBuffer_;
+    /// One per chunk
+    std::vector<CommandBuffer> commandBuffers_;
+    bool budgeted_{ false };
+    std::size_t batchSize_{ 0 };
+    /// Collected entities left over by budgeted executions
+    Entities backlog_;
+    std::size_t backlogPosition_{ 0 };
+    PooledSet<Entity*> pendingEntities_;
+#ifdef ENTITAS_PROFILE
+    /// The subsystem executing the entities, without the collecting and
+    /// filtering around it
+    Profiler::SectionId section_;
+#endif
+#ifdef ENTITAS_FLIGHT_RECORDER
+    /// Entities handed to the subsystem
+    FlightRecorder::NameId recorderName_;
+#endif
 };
 }
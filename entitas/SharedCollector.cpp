@@ -0,0 +1,208 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#include "SharedCollector.hpp"
+#include "MemoryReport.hpp"
+#include <algorithm>
+
+namespace entitas {
+
+namespace {
+    /// Smaller logs are not worth squeezing
+    const size_t kMinSqueezedLog = 64;
+}
+
+SharedCollector::SharedCollector(std::vector<Group::WeakPtr>&& groups, std::vector<GroupEventType>&& eventTypes)
+    : Collector(std::move(groups), std::move(eventTypes))
+{
+}
+
+auto SharedCollector::addConsumer() -> ConsumerId
+{
+    ConsumerId consumer = 0;
+    while (consumer < consumers_.size() && consumers_[consumer].used) {
+        ++consumer;
+    }
+
+    if (consumer == consumers_.size()) {
+        consumers_.emplace_back();
+    }
+
+    consumers_[consumer].used = true;
+    activateConsumer(consumer);
+    return consumer;
+}
+
+void SharedCollector::removeConsumer(ConsumerId consumer)
+{
+    deactivateConsumer(consumer);
+    consumers_[consumer].used = false;
+}
+
+void SharedCollector::activateConsumer(ConsumerId consumer)
+{
+    auto& c = consumers_[consumer];
+    if (!c.active) {
+        c.active = true;
+        c.cursor = getEnd();
+        ++activeCount_;
+    }
+}
+
+void SharedCollector::deactivateConsumer(ConsumerId consumer)
+{
+    auto& c = consumers_[consumer];
+    if (c.active) {
+        c.active = false;
+        --activeCount_;
+        compact();
+    }
+}
+
+bool SharedCollector::hasCollectedEntities(ConsumerId consumer) const
+{
+    const auto& c = consumers_[consumer];
+    for (auto i = c.cursor - base_, size = log_.size(); i < size; ++i) {
+        if (log_[i]) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void SharedCollector::readCollectedEntities(ConsumerId consumer, Entities& entities)
+{
+    auto& c = consumers_[consumer];
+    if (!c.active) {
+        return;
+    }
+
+    for (auto i = c.cursor - base_, size = log_.size(); i < size; ++i) {
+        if (log_[i]) {
+            entities.push_back(log_[i]);
+        }
+    }
+
+    c.cursor = getEnd();
+    compact();
+}
+
+void SharedCollector::clearCollectedEntities(ConsumerId consumer)
+{
+    consumers_[consumer].cursor = getEnd();
+    compact();
+}
+
+auto SharedCollector::getConsumerCount() const -> unsigned int
+{
+    unsigned int count = 0;
+    for (const auto& c : consumers_) {
+        count += c.used ? 1 : 0;
+    }
+
+    return count;
+}
+
+auto SharedCollector::getLogSize() const -> size_t
+{
+    return log_.size();
+}
+
+auto SharedCollector::getMemoryBytes() const -> size_t
+{
+    return memory::getHeapBytes(log_) + memory::getHeapBytes(latest_) + memory::getHeapBytes(consumers_);
+}
+
+void SharedCollector::collect(const EntityPtr& entity)
+{
+    if (activeCount_ == 0) {
+        return;
+    }
+
+    auto position = getEnd();
+    auto it = latest_.find(entity.get());
+
+    if (it == latest_.end()) {
+        latest_.emplace(entity.get(), position);
+    } else {
+        // Consumers that have not read the old entry will read this one
+        log_[it->second - base_].reset();
+        it->second = position;
+        ++nulls_;
+    }
+
+    log_.push_back(entity);
+    ENTITAS_COUNT(CollectorInserts);
+
+    if (log_.size() >= kMinSqueezedLog && nulls_ * 2 > log_.size()) {
+        squeeze();
+    }
+}
+
+auto SharedCollector::getEnd() const -> size_t
+{
+    return base_ + log_.size();
+}
+
+void SharedCollector::compact()
+{
+    if (activeCount_ == 0) {
+        log_.clear();
+        latest_.clear();
+        base_ = 0;
+        nulls_ = 0;
+        return;
+    }
+
+    auto oldest = getEnd();
+    for (const auto& c : consumers_) {
+        if (c.active && c.cursor < oldest) {
+            oldest = c.cursor;
+        }
+    }
+
+    // Only when it pays off, the remaining entries have to be moved
+    auto count = oldest - base_;
+    if (count == 0 || count * 2 < log_.size()) {
+        return;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        if (log_[i]) {
+            latest_.erase(log_[i].get());
+        } else {
+            --nulls_;
+        }
+    }
+
+    log_.erase(log_.begin(), log_.begin() + count);
+    base_ = oldest;
+}
+
+void SharedCollector::squeeze()
+{
+    // A cursor moves to the number of entries left before it
+    auto isLive = [](const EntityPtr& entity) { return entity != nullptr; };
+    for (auto& c : consumers_) {
+        if (c.active) {
+            c.cursor = base_ + std::count_if(log_.begin(), log_.begin() + (c.cursor - base_), isLive);
+        }
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0, size = log_.size(); i < size; ++i) {
+        if (log_[i]) {
+            latest_.find(log_[i].get())->second = base_ + kept;
+            if (i != kept) {
+                log_[kept] = std::move(log_[i]);
+            }
+            ++kept;
+        }
+    }
+
+    log_.resize(kept);
+    nulls_ = 0;
+}
+}
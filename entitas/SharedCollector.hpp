@@ -0,0 +1,77 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "Collector.hpp"
+#include <unordered_map>
+#include <vector>
+
+namespace entitas {
+
+/// A Collector read by several consumers, e.g. all the reactive systems
+/// with the same triggers. Use context.getSharedCollector(triggers) to get
+/// the one for a set of triggers.
+///
+/// Collected entities are appended once to a shared log and every consumer
+/// reads it from its own cursor. Collecting an entity again supersedes its
+/// previous entry, so each consumer sees every entity at most once per read
+/// and in the order it was last collected. Superseded entries are squeezed
+/// out once they make up half of the log, so a consumer that lags behind
+/// keeps it within a small multiple of the entities it has not read.
+class SharedCollector : public Collector {
+public:
+    using ConsumerId = size_t;
+
+    SharedCollector(std::vector<Group::WeakPtr>&& groups, std::vector<GroupEventType>&& eventTypes);
+
+    /// Adds an active consumer which will see the entities collected
+    /// from now on.
+    auto addConsumer() -> ConsumerId;
+    void removeConsumer(ConsumerId consumer);
+    /// Inactive consumers collect nothing.
+    /// Activating a consumer starts it with nothing collected.
+    void activateConsumer(ConsumerId consumer);
+    void deactivateConsumer(ConsumerId consumer);
+
+    bool hasCollectedEntities(ConsumerId consumer) const;
+    /// Appends the entities collected for the consumer since its last
+    /// read and marks them as read.
+    void readCollectedEntities(ConsumerId consumer, Entities& entities);
+    void clearCollectedEntities(ConsumerId consumer);
+    auto getConsumerCount() const -> unsigned int;
+    /// Entries in the log, superseded ones included
+    auto getLogSize() const -> size_t;
+    /// Estimated heap bytes of the log and its bookkeeping
+    auto getMemoryBytes() const -> size_t;
+
+protected:
+    void collect(const EntityPtr& entity) override;
+
+private:
+    struct Consumer {
+        /// Absolute position in the log of the next entry to read
+        size_t cursor{ 0 };
+        bool active{ false };
+        bool used{ false };
+    };
+
+    auto getEnd() const -> size_t;
+    /// Drops the entries every active consumer has read
+    void compact();
+    /// Drops the superseded entries, moving the cursors along
+    void squeeze();
+
+    /// Superseded entries are null
+    Entities log_;
+    /// Superseded entries in log_
+    size_t nulls_{ 0 };
+    /// Absolute position of log_[0]
+    size_t base_{ 0 };
+    /// Absolute position of the latest entry of every entity in the log
+    PooledMap<Entity*, size_t> latest_;
+    std::vector<Consumer> consumers_;
+    unsigned int activeCount_{ 0 };
+};
+}
@@ -0,0 +1,242 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "Collector.hpp"
+#include "Group.hpp"
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+namespace entitas {
+
+/// Keeps the entities of a group ordered by a comparator on one of their
+/// components, e.g. render depth or AI priority.
+/// Changes of the group are recorded as they happen and the order is
+/// repaired the next time the entities are requested: a few changes are
+/// inserted in place, many changes are sorted and merged in one pass.
+/// The component must be part of the group's matcher.
+template <typename TComponent>
+class SortedGroup : public Indexed {
+public:
+    using Compare = std::function<bool(const TComponent&, const TComponent&)>;
+
+    /// Up to this many changed entities are inserted one by one,
+    /// above it they are merged
+    static const size_t kInsertionThreshold = 16;
+
+    SortedGroup(Group::SharedPtr group, Compare compare);
+    ~SortedGroup();
+
+    /// Sorts all entities already in the group and starts listening to
+    /// its changes. Sorted groups are activated by default.
+    void activate();
+    void deactivate();
+
+    /// Returns the entities of the group in order.
+    auto getEntities() -> const Entities&;
+    auto count() const -> unsigned int;
+
+private:
+    /// What happened to an entity since the last repair
+    struct Change {
+        EntityPtr entity;
+        /// Entity has to be taken out of 'entities_'
+        bool sorted{ false };
+        /// Entity has to be (re)inserted into 'entities_'
+        bool member{ false };
+    };
+
+    void onEntityAdded(const Group::SharedPtr& group, const EntityPtr& entity, ComponentId index, IComponent* component);
+    void onEntityRemoved(const Group::SharedPtr& group, const EntityPtr& entity, ComponentId index, IComponent* component);
+    void onEntityUpdated(const Group::SharedPtr& group, const EntityPtr& entity, ComponentId index, IComponent* previousComponent, IComponent* newComponent);
+    auto getChange(const EntityPtr& entity, bool sorted) -> Change&;
+    bool less(const EntityPtr& left, const EntityPtr& right) const;
+    void repair();
+    void unsubscribe();
+
+    Group::WeakPtr group_;
+    Compare compare_;
+    Entities entities_;
+    PooledMap<Entity*, Change> changes_;
+    Entities insertBuffer_;
+    size_t count_{ 0 };
+
+    std::function<void(const Group::SharedPtr&, const EntityPtr&, ComponentId, IComponent*)> onEntityAddedCache_;
+    std::function<void(const Group::SharedPtr&, const EntityPtr&, ComponentId, IComponent*)> onEntityRemovedCache_;
+    std::function<void(const Group::SharedPtr&, const EntityPtr&, ComponentId, IComponent*, IComponent*)> onEntityUpdatedCache_;
+};
+
+/* -------------------------------------------------------------------------- */
+
+template <typename TComponent>
+SortedGroup<TComponent>::SortedGroup(Group::SharedPtr group, Compare compare)
+    : group_{ group }
+    , compare_{ compare }
+{
+    using namespace std::placeholders;
+    onEntityAddedCache_ = std::bind(&SortedGroup::onEntityAdded, this, _1, _2, _3, _4);
+    onEntityRemovedCache_ = std::bind(&SortedGroup::onEntityRemoved, this, _1, _2, _3, _4);
+    onEntityUpdatedCache_ = std::bind(&SortedGroup::onEntityUpdated, this, _1, _2, _3, _4, _5);
+
+    activate();
+}
+
+template <typename TComponent>
+SortedGroup<TComponent>::~SortedGroup()
+{
+    unsubscribe();
+}
+
+template <typename TComponent>
+void SortedGroup<TComponent>::activate()
+{
+    auto group = group_.lock();
+    if (!group) {
+        return;
+    }
+
+    unsubscribe();
+    group->onEntityAdded += { index(), onEntityAddedCache_ };
+    group->onEntityRemoved += { index(), onEntityRemovedCache_ };
+    group->onEntityUpdated += { index(), onEntityUpdatedCache_ };
+
+    changes_.clear();
+    entities_ = group->getEntities();
+    count_ = entities_.size();
+    std::stable_sort(entities_.begin(), entities_.end(),
+        [this](const EntityPtr& left, const EntityPtr& right) { return less(left, right); });
+}
+
+template <typename TComponent>
+void SortedGroup<TComponent>::deactivate()
+{
+    unsubscribe();
+    entities_.clear();
+    changes_.clear();
+    count_ = 0;
+}
+
+template <typename TComponent>
+auto SortedGroup<TComponent>::getEntities() -> const Entities&
+{
+    if (!changes_.empty()) {
+        repair();
+    }
+
+    return entities_;
+}
+
+template <typename TComponent>
+auto SortedGroup<TComponent>::count() const -> unsigned int
+{
+    return static_cast<unsigned>(count_);
+}
+
+template <typename TComponent>
+void SortedGroup<TComponent>::onEntityAdded(const Group::SharedPtr& group, const EntityPtr& entity, ComponentId index, IComponent* component)
+{
+    auto& change = getChange(entity, false);
+    if (!change.member) {
+        change.member = true;
+        ++count_;
+    }
+}
+
+template <typename TComponent>
+void SortedGroup<TComponent>::onEntityRemoved(const Group::SharedPtr& group, const EntityPtr& entity, ComponentId index, IComponent* component)
+{
+    auto& change = getChange(entity, true);
+    if (change.member) {
+        change.member = false;
+        --count_;
+    }
+}
+
+template <typename TComponent>
+void SortedGroup<TComponent>::onEntityUpdated(const Group::SharedPtr& group, const EntityPtr& entity, ComponentId index, IComponent* previousComponent, IComponent* newComponent)
+{
+    // Replacing any other component keeps the order
+    if (index != ComponentTypeId::get<TComponent>()) {
+        return;
+    }
+
+    // The entity moves: take it out and insert it again
+    getChange(entity, true);
+}
+
+template <typename TComponent>
+auto SortedGroup<TComponent>::getChange(const EntityPtr& entity, bool sorted) -> Change&
+{
+    auto it = changes_.find(entity.get());
+    if (it != changes_.end()) {
+        return it->second;
+    }
+
+    // First change since the last repair, so 'sorted' tells whether the
+    // entity is currently in 'entities_' and 'member' starts the same
+    auto& change = changes_[entity.get()];
+    change.entity = entity;
+    change.sorted = sorted;
+    change.member = sorted;
+    return change;
+}
+
+template <typename TComponent>
+bool SortedGroup<TComponent>::less(const EntityPtr& left, const EntityPtr& right) const
+{
+    return compare_(*left->template get<TComponent>(), *right->template get<TComponent>());
+}
+
+template <typename TComponent>
+void SortedGroup<TComponent>::repair()
+{
+    bool anySorted = false;
+    insertBuffer_.clear();
+
+    for (const auto& pair : changes_) {
+        anySorted = anySorted || pair.second.sorted;
+        if (pair.second.member) {
+            insertBuffer_.push_back(pair.second.entity);
+        }
+    }
+
+    if (anySorted) {
+        entities_.erase(std::remove_if(entities_.begin(), entities_.end(),
+                            [this](const EntityPtr& e) {
+                                auto it = changes_.find(e.get());
+                                return it != changes_.end() && it->second.sorted;
+                            }),
+            entities_.end());
+    }
+
+    changes_.clear();
+
+    auto compare = [this](const EntityPtr& left, const EntityPtr& right) { return less(left, right); };
+
+    if (insertBuffer_.size() <= kInsertionThreshold) {
+        for (auto& e : insertBuffer_) {
+            entities_.insert(std::upper_bound(entities_.begin(), entities_.end(), e, compare), std::move(e));
+        }
+    } else {
+        std::sort(insertBuffer_.begin(), insertBuffer_.end(), compare);
+        auto middle = entities_.size();
+        entities_.insert(entities_.end(), std::make_move_iterator(insertBuffer_.begin()), std::make_move_iterator(insertBuffer_.end()));
+        std::inplace_merge(entities_.begin(), entities_.begin() + middle, entities_.end(), compare);
+    }
+
+    insertBuffer_.clear();
+}
+
+template <typename TComponent>
+void SortedGroup<TComponent>::unsubscribe()
+{
+    if (auto group = group_.lock()) {
+        group->onEntityAdded -= { index(), onEntityAddedCache_ };
+        group->onEntityRemoved -= { index(), onEntityRemovedCache_ };
+        group->onEntityUpdated -= { index(), onEntityUpdatedCache_ };
+    }
+}
+}
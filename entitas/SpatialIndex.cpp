@@ -0,0 +1,184 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#include "SpatialIndex.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace entitas {
+
+SpatialHash::SpatialHash(float cellSize)
+    : cellSize_{ cellSize }
+{
+    if (cellSize <= 0.f) {
+        throw std::runtime_error("Error, spatial hash cell size must be greater than zero");
+    }
+
+    inverseCellSize_ = 1.f / cellSize;
+}
+
+void SpatialHash::insert(const EntityPtr& entity, const Aabb& bounds)
+{
+    auto cells = getCellRange(bounds);
+    auto it = items_.find(entity.get());
+
+    if (it == items_.end()) {
+        auto& item = items_[entity.get()];
+        item.entity = entity;
+        item.bounds = bounds;
+        item.cells = cells;
+        addToCells(&item);
+        return;
+    }
+
+    auto& item = it->second;
+    item.bounds = bounds;
+
+    // Most moves stay within the same cells
+    if (!(item.cells == cells)) {
+        removeFromCells(&item);
+        item.cells = cells;
+        addToCells(&item);
+    }
+}
+
+void SpatialHash::remove(const EntityPtr& entity)
+{
+    auto it = items_.find(entity.get());
+    if (it == items_.end()) {
+        return;
+    }
+
+    removeFromCells(&it->second);
+    items_.erase(it);
+}
+
+void SpatialHash::clear()
+{
+    cells_.clear();
+    items_.clear();
+}
+
+bool SpatialHash::contains(const EntityPtr& entity) const
+{
+    return items_.find(entity.get()) != items_.end();
+}
+
+auto SpatialHash::count() const -> unsigned int
+{
+    return static_cast<unsigned>(items_.size());
+}
+
+void SpatialHash::queryPoint(float x, float y, Entities& result) const
+{
+    auto it = cells_.find(getCellKey(static_cast<int>(std::floor(x * inverseCellSize_)),
+        static_cast<int>(std::floor(y * inverseCellSize_))));
+
+    if (it == cells_.end()) {
+        return;
+    }
+
+    // A point falls in a single cell, so no entity can be visited twice
+    for (const auto item : it->second) {
+        if (item->bounds.contains(x, y)) {
+            result.push_back(item->entity);
+        }
+    }
+}
+
+void SpatialHash::queryAabb(const Aabb& area, Entities& result) const
+{
+    forEachCandidate(area, [&](const Item* item) {
+        if (item->bounds.intersects(area)) {
+            result.push_back(item->entity);
+        }
+    });
+}
+
+void SpatialHash::queryRadius(float x, float y, float radius, Entities& result) const
+{
+    auto radiusSquared = radius * radius;
+    auto area = Aabb{ x - radius, y - radius, x + radius, y + radius };
+
+    forEachCandidate(area, [&](const Item* item) {
+        // Distance from the center to the closest point of the box
+        auto dx = x - std::max(item->bounds.minX, std::min(x, item->bounds.maxX));
+        auto dy = y - std::max(item->bounds.minY, std::min(y, item->bounds.maxY));
+
+        if (dx * dx + dy * dy <= radiusSquared) {
+            result.push_back(item->entity);
+        }
+    });
+}
+
+auto SpatialHash::getCellRange(const Aabb& bounds) const -> CellRange
+{
+    return CellRange{
+        static_cast<int>(std::floor(bounds.minX * inverseCellSize_)),
+        static_cast<int>(std::floor(bounds.minY * inverseCellSize_)),
+        static_cast<int>(std::floor(bounds.maxX * inverseCellSize_)),
+        static_cast<int>(std::floor(bounds.maxY * inverseCellSize_))
+    };
+}
+
+auto SpatialHash::getCellKey(int x, int y) -> CellKey
+{
+    return (static_cast<CellKey>(static_cast<std::uint32_t>(x)) << 32) | static_cast<std::uint32_t>(y);
+}
+
+void SpatialHash::addToCells(const Item* item)
+{
+    for (auto x = item->cells.minX; x <= item->cells.maxX; ++x) {
+        for (auto y = item->cells.minY; y <= item->cells.maxY; ++y) {
+            cells_[getCellKey(x, y)].push_back(item);
+        }
+    }
+}
+
+void SpatialHash::removeFromCells(const Item* item)
+{
+    for (auto x = item->cells.minX; x <= item->cells.maxX; ++x) {
+        for (auto y = item->cells.minY; y <= item->cells.maxY; ++y) {
+            auto it = cells_.find(getCellKey(x, y));
+            if (it == cells_.end()) {
+                continue;
+            }
+
+            auto& cell = it->second;
+            auto found = std::find(cell.begin(), cell.end(), item);
+            if (found != cell.end()) {
+                *found = cell.back();
+                cell.pop_back();
+            }
+
+            if (cell.empty()) {
+                cells_.erase(it);
+            }
+        }
+    }
+}
+
+template <typename F>
+void SpatialHash::forEachCandidate(const Aabb& area, F fn) const
+{
+    auto range = getCellRange(area);
+    auto stamp = ++queryStamp_;
+
+    for (auto x = range.minX; x <= range.maxX; ++x) {
+        for (auto y = range.minY; y <= range.maxY; ++y) {
+            auto it = cells_.find(getCellKey(x, y));
+            if (it == cells_.end()) {
+                continue;
+            }
+
+            for (const auto item : it->second) {
+                if (item->queryStamp != stamp) {
+                    item->queryStamp = stamp;
+                    fn(item);
+                }
+            }
+        }
+    }
+}
+}
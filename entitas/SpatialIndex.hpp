@@ -0,0 +1,163 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "EntityIndex.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace entitas {
+
+/// Axis aligned bounding box. A point is a box with min == max.
+struct Aabb {
+    float minX{ 0.f };
+    float minY{ 0.f };
+    float maxX{ 0.f };
+    float maxY{ 0.f };
+
+    bool contains(float x, float y) const
+    {
+        return x >= minX && x <= maxX && y >= minY && y <= maxY;
+    }
+
+    bool intersects(const Aabb& other) const
+    {
+        return minX <= other.maxX && maxX >= other.minX && minY <= other.maxY && maxY >= other.minY;
+    }
+
+    bool operator==(const Aabb& other) const
+    {
+        return minX == other.minX && minY == other.minY && maxX == other.maxX && maxY == other.maxY;
+    }
+};
+
+/// Uniform grid that buckets entities by the cells their bounds overlap.
+/// Queries only visit the cells covering the queried area instead of
+/// every entity.
+class SpatialHash {
+public:
+    explicit SpatialHash(float cellSize);
+
+    /// Inserts the entity or moves it if it is already in the grid.
+    void insert(const EntityPtr& entity, const Aabb& bounds);
+    void remove(const EntityPtr& entity);
+    void clear();
+
+    bool contains(const EntityPtr& entity) const;
+    auto count() const -> unsigned int;
+    float getCellSize() const { return cellSize_; }
+
+    /// Queries append the found entities to 'result', each entity once.
+    /// Queries are not thread safe, they mark visited entities.
+    void queryPoint(float x, float y, Entities& result) const;
+    void queryAabb(const Aabb& area, Entities& result) const;
+    void queryRadius(float x, float y, float radius, Entities& result) const;
+
+private:
+    struct CellRange {
+        int minX, minY, maxX, maxY;
+        bool operator==(const CellRange& other) const
+        {
+            return minX == other.minX && minY == other.minY && maxX == other.maxX && maxY == other.maxY;
+        }
+    };
+
+    struct Item {
+        EntityPtr entity;
+        Aabb bounds;
+        CellRange cells;
+        /// Last query that visited this item, so entities spanning several
+        /// cells are only reported once
+        mutable unsigned int queryStamp{ 0 };
+    };
+
+    using CellKey = std::uint64_t;
+    using Cell = std::vector<const Item*>;
+
+    auto getCellRange(const Aabb& bounds) const -> CellRange;
+    static auto getCellKey(int x, int y) -> CellKey;
+    void addToCells(const Item* item);
+    void removeFromCells(const Item* item);
+    /// Calls 'fn' once for every item in the cells overlapping 'area'
+    template <typename F>
+    void forEachCandidate(const Aabb& area, F fn) const;
+
+    float cellSize_;
+    float inverseCellSize_;
+    std::unordered_map<CellKey, Cell> cells_;
+    PooledMap<Entity*, Item> items_;
+    mutable unsigned int queryStamp_{ 0 };
+};
+
+/* -------------------------------------------------------------------------- */
+
+/// Keeps the entities of a group in a SpatialHash, using the bounds
+/// returned by 'getBounds' for the given component.
+/// The index follows replacements of the component, so moving an entity
+/// only touches the cells it left and entered.
+template <typename TComponent>
+class SpatialIndex : public AbstractEntityIndex<TComponent, Aabb> {
+public:
+    using GetBounds = typename AbstractEntityIndex<TComponent, Aabb>::GetKey;
+
+    SpatialIndex(Group::SharedPtr group, GetBounds getBounds, float cellSize);
+    ~SpatialIndex();
+
+    void queryPoint(float x, float y, Entities& result) const { hash_.queryPoint(x, y, result); }
+    void queryAabb(const Aabb& area, Entities& result) const { hash_.queryAabb(area, result); }
+    void queryRadius(float x, float y, float radius, Entities& result) const { hash_.queryRadius(x, y, radius, result); }
+    auto count() const -> unsigned int { return hash_.count(); }
+
+protected:
+    void addEntity(const Aabb& bounds, const EntityPtr& entity) override;
+    void removeEntity(const Aabb& bounds, const EntityPtr& entity) override;
+    void updateEntity(const Aabb& previousBounds, const Aabb& newBounds, const EntityPtr& entity) override;
+    void clear() override;
+
+private:
+    SpatialHash hash_;
+};
+
+/* -------------------------------------------------------------------------- */
+
+template <typename TComponent>
+SpatialIndex<TComponent>::SpatialIndex(Group::SharedPtr group, GetBounds getBounds, float cellSize)
+    : AbstractEntityIndex<TComponent, Aabb>(group, getBounds)
+    , hash_{ cellSize }
+{
+    this->activate();
+}
+
+template <typename TComponent>
+SpatialIndex<TComponent>::~SpatialIndex()
+{
+    this->deactivate();
+}
+
+template <typename TComponent>
+void SpatialIndex<TComponent>::addEntity(const Aabb& bounds, const EntityPtr& entity)
+{
+    hash_.insert(entity, bounds);
+}
+
+template <typename TComponent>
+void SpatialIndex<TComponent>::removeEntity(const Aabb& bounds, const EntityPtr& entity)
+{
+    hash_.remove(entity);
+}
+
+template <typename TComponent>
+void SpatialIndex<TComponent>::updateEntity(const Aabb& previousBounds, const Aabb& newBounds, const EntityPtr& entity)
+{
+    hash_.insert(entity, newBounds);
+}
+
+template <typename TComponent>
+void SpatialIndex<TComponent>::clear()
+{
+    hash_.clear();
+}
+}
@@ -4,10 +4,12 @@
 
 #include "SystemContainer.hpp"
 #include "ReactiveSystem.hpp"
+#include "TypeName.hpp"
 
-#include "Functional.hpp"
-
+#include <algorithm>
+#include <cmath>
 #include <memory>
+#include <stdexcept>
 
 namespace entitas {
 using std::dynamic_pointer_cast;
@@ -35,78 +37,233 @@ auto SystemContainer::add(std::shared_ptr<ISystem> system) -> SystemContainer*
         }
     }
 
-    if (auto systemExecute = dynamic_pointer_cast<IExecuteSystem>(system)) {
+    if (auto systemBudgeted = getBudgeted(system)) {
+        addBudgeted(systemBudgeted);
+    } else if (auto systemExecute = dynamic_pointer_cast<IExecuteSystem>(system)) {
         executeSystems_.push_back(systemExecute);
+        schedules_.emplace_back();
+        schedules_.back().container = dynamic_cast<SystemContainer*>(systemExecute.get());
+    }
+
+#ifdef ENTITAS_SYSTEM_NAMES
+    if (auto systemReactive = dynamic_pointer_cast<ReactiveSystem>(system)) {
+        setName(system, getTypeName(typeid(*systemReactive->getSubsystem())));
+    } else {
+        setName(system, getTypeName(typeid(*system)));
     }
+#endif
 
     return this;
 }
 
-void SystemContainer::initialize()
+auto SystemContainer::add(std::shared_ptr<ISystem> system, double frequency, unsigned int maxStepsPerFrame) -> SystemContainer*
 {
-    for_each(initializeSystems_, std::mem_fn(&IInitializeSystem::initialize));
+    if (frequency <= 0.0 || maxStepsPerFrame == 0) {
+        throw std::runtime_error("Error, a system needs a positive frequency and at least one step per frame");
+    }
+
+    if (getBudgeted(system) || !dynamic_pointer_cast<IExecuteSystem>(system)) {
+        throw std::runtime_error("Error, only execute systems can be added at a rate");
+    }
+
+    add(std::move(system));
+
+    // Golden ratio offsets spread any number of systems evenly over a step
+    const double kGoldenRatio = 0.6180339887498949;
+    auto phase = std::fmod(scheduledCount_++ * kGoldenRatio, 1.0);
+
+    auto& schedule = schedules_.back();
+    schedule.interval = 1.0 / frequency;
+    schedule.accumulated = phase * schedule.interval;
+    schedule.maxSteps = maxStepsPerFrame;
+
+    return this;
 }
 
-void SystemContainer::execute()
+auto SystemContainer::getBudgeted(const std::shared_ptr<ISystem>& system) -> std::shared_ptr<IBudgetedSystem>
 {
-    for_each(executeSystems_, std::mem_fn(&IExecuteSystem::execute));
+    // Reactive systems are budgeted only when their subsystem is
+    if (auto systemReactive = dynamic_pointer_cast<ReactiveSystem>(system)) {
+        if (!systemReactive->isBudgeted()) {
+            return nullptr;
+        }
+    }
+
+    return dynamic_pointer_cast<IBudgetedSystem>(system);
 }
 
-void SystemContainer::cleanup()
+void SystemContainer::setName(const std::shared_ptr<ISystem>& system, const std::string& name)
 {
-    for_each(cleanupSystems_, std::mem_fn(&ICleanupSystem::cleanup));
+#ifdef ENTITAS_SYSTEM_NAMES
+    Sections sections;
+#ifdef ENTITAS_PROFILE
+    auto& profiler = Profiler::get();
+    sections.initialize = profiler.getSection(name + ".initialize");
+    sections.execute = profiler.getSection(name);
+    sections.cleanup = profiler.getSection(name + ".cleanup");
+    sections.teardown = profiler.getSection(name + ".teardown");
+#endif
+#ifdef ENTITAS_FLIGHT_RECORDER
+    sections.recorderName = FlightRecorder::getName(name);
+#endif
+#ifdef ENTITAS_HARDWARE_COUNTERS
+    sections.hardware = HardwareCounters::get().getSystem(name);
+#endif
+
+    sections_[dynamic_cast<const void*>(system.get())] = sections;
+    if (auto systemReactive = dynamic_pointer_cast<ReactiveSystem>(system)) {
+        sections_[dynamic_cast<const void*>(systemReactive->getSubsystem().get())] = sections;
+    }
+#else
+    (void)system;
+    (void)name;
+#endif
 }
 
-void SystemContainer::teardown()
+#ifdef ENTITAS_SYSTEM_NAMES
+auto SystemContainer::getSections(const void* object) const -> const Sections&
 {
-    for_each(teardownSystems_, std::mem_fn(&ITearDownSystem::teardown));
+    auto it = sections_.find(object);
+    if (it == sections_.end()) {
+        throw std::runtime_error("Error, system has not been added to this container");
+    }
+
+    return it->second;
 }
+#endif
 
-#if 0
-void SystemContainer::fixedExecute()
+void SystemContainer::initialize()
 {
-    for (const auto& system : mFixedExecuteSystems) {
-        system->fixedExecute();
+    for (const auto& system : initializeSystems_) {
+        ENTITAS_PROFILE_SECTION_SCOPE(getSections(system.get()).initialize);
+        ENTITAS_RECORD_SYSTEM(getSections(system.get()).recorderName, Initialize);
+        system->initialize();
     }
 }
-#endif
 
-void SystemContainer::activateReactiveSystems()
+void SystemContainer::execute()
+{
+    auto now = std::chrono::steady_clock::now();
+    auto deltaTime = 0.0;
+    if (lastExecute_ != std::chrono::steady_clock::time_point{}) {
+        deltaTime = std::chrono::duration<double>(now - lastExecute_).count();
+    }
+
+    lastExecute_ = now;
+    execute(deltaTime);
+}
+
+void SystemContainer::execute(double deltaTime)
 {
-    for (const auto& system : executeSystems_) {
-        if (dynamic_pointer_cast<ReactiveSystem>(system) != nullptr) {
-            (dynamic_pointer_cast<ReactiveSystem>(system))->activate();
+    ENTITAS_PROFILE_FRAME();
+    ENTITAS_RECORD_FRAME();
+    ENTITAS_HARDWARE_FRAME();
+    for (std::size_t i = 0; i < executeSystems_.size(); ++i) {
+        auto& schedule = schedules_[i];
+        if (schedule.interval == 0.0) {
+            executeStep(i, deltaTime);
+            continue;
         }
 
-        if (dynamic_pointer_cast<SystemContainer>(system) != nullptr) {
-            (dynamic_pointer_cast<SystemContainer>(system))->activateReactiveSystems();
+        schedule.accumulated += deltaTime;
+        for (unsigned int step = 0; step < schedule.maxSteps && schedule.accumulated >= schedule.interval; ++step) {
+            schedule.accumulated -= schedule.interval;
+            executeStep(i, schedule.interval);
         }
+
+        // Drop what could not be caught up, keeping the phase
+        if (schedule.accumulated >= schedule.interval) {
+            auto behind = std::floor(schedule.accumulated / schedule.interval);
+            droppedSteps_ += static_cast<unsigned long>(behind);
+            schedule.accumulated -= behind * schedule.interval;
+        }
+    }
+
+    if (budgetedSystems_.empty()) {
+        return;
+    }
+
+    auto budget = ExecutionBudget(budget_);
+    for (const auto& system : budgetedSystems_) {
+        if (budget.isExhausted()) {
+            break;
+        }
+
+        ENTITAS_PROFILE_SECTION_SCOPE(getSections(system.get()).execute);
+        ENTITAS_RECORD_SYSTEM(getSections(system.get()).recorderName, Execute);
+        ENTITAS_HARDWARE_SCOPE(getSections(system.get()).hardware);
+        auto systemBudget = budget.limitedTo(system->limits);
+        system->execute(systemBudget);
+        budget.consume(systemBudget.getConsumedItems());
     }
 }
 
-void SystemContainer::deactivateReactiveSystems()
+void SystemContainer::cleanup()
 {
-    for (const auto& system : executeSystems_) {
-        if (auto systemReactive = dynamic_pointer_cast<ReactiveSystem>(system)) {
-            systemReactive->deactivate();
-        }
+    for (const auto& system : cleanupSystems_) {
+        ENTITAS_PROFILE_SECTION_SCOPE(getSections(system.get()).cleanup);
+        ENTITAS_RECORD_SYSTEM(getSections(system.get()).recorderName, Cleanup);
+        system->cleanup();
+    }
+}
 
-        if (auto systemContainer = dynamic_pointer_cast<SystemContainer>(system)) {
-            systemContainer->deactivateReactiveSystems();
-        }
+void SystemContainer::teardown()
+{
+    for (const auto& system : teardownSystems_) {
+        ENTITAS_PROFILE_SECTION_SCOPE(getSections(system.get()).teardown);
+        ENTITAS_RECORD_SYSTEM(getSections(system.get()).recorderName, Teardown);
+        system->teardown();
+    }
+}
+
+void SystemContainer::executeStep(std::size_t index, double deltaTime)
+{
+    ENTITAS_PROFILE_SECTION_SCOPE(getSections(executeSystems_[index].get()).execute);
+    ENTITAS_RECORD_SYSTEM(getSections(executeSystems_[index].get()).recorderName, Execute);
+    ENTITAS_HARDWARE_SCOPE(getSections(executeSystems_[index].get()).hardware);
+    // Nested containers share the time of their step
+    if (auto container = schedules_[index].container) {
+        container->execute(deltaTime);
+    } else {
+        executeSystems_[index]->execute();
     }
 }
 
+auto SystemContainer::getDroppedStepsCount() const -> unsigned long
+{
+    return droppedSteps_;
+}
+
+void SystemContainer::activateReactiveSystems()
+{
+    forEachReactiveSystem([](ReactiveSystem& system) { system.activate(); });
+}
+
+void SystemContainer::deactivateReactiveSystems()
+{
+    forEachReactiveSystem([](ReactiveSystem& system) { system.deactivate(); });
+}
+
 void SystemContainer::clearReactiveSystems()
 {
-    for_each(executeSystems_, [&](const auto& system) {
-        if (auto systemReactive = dynamic_pointer_cast<ReactiveSystem>(system)) {
-            systemReactive->clear();
-        }
+    forEachReactiveSystem([](ReactiveSystem& system) { system.clear(); });
+}
 
-        if (auto systemContainer = dynamic_pointer_cast<SystemContainer>(system)) {
-            systemContainer->clearReactiveSystems();
-        }
-    });
+void SystemContainer::setBudget(const ExecutionLimits& limits)
+{
+    budget_ = limits;
+}
+
+auto SystemContainer::getBudget() const -> const ExecutionLimits&
+{
+    return budget_;
+}
+
+void SystemContainer::addBudgeted(std::shared_ptr<IBudgetedSystem> system)
+{
+    // After the ones with the same priority
+    auto position = std::upper_bound(budgetedSystems_.begin(), budgetedSystems_.end(), system->priority,
+        [](int priority, const std::shared_ptr<IBudgetedSystem>& other) { return priority > other->priority; });
+    budgetedSystems_.insert(position, std::move(system));
 }
 }
@@ -6,24 +6,55 @@
 
 #include "ISystem.hpp"
 #include "Context.hpp"
+#include "FlightRecorder.hpp"
+#include "HardwareCounters.hpp"
+#include "Profiler.hpp"
+#include "ReactiveSystem.hpp"
+#include <chrono>
+#include <string>
 #include <vector>
 
+/// Systems are named for one of the diagnostics
+#if defined(ENTITAS_PROFILE) || defined(ENTITAS_FLIGHT_RECORDER) || defined(ENTITAS_HARDWARE_COUNTERS)
+#define ENTITAS_SYSTEM_NAMES
+#endif
+
 namespace entitas {
 class SystemContainer : public IInitializeSystem, public IExecuteSystem, public ICleanupSystem, public ITearDownSystem {
 public:
     SystemContainer() = default;
 
     auto add(std::shared_ptr<ISystem> system) -> SystemContainer*;
+    /// Adds a system executed 'frequency' times per second instead of once
+    /// per frame, in fixed steps. A frame runs at most 'maxStepsPerFrame'
+    /// steps of it, the ones it falls behind beyond that are dropped.
+    /// Systems added at a rate are staggered so they don't all become due
+    /// on the same frame. A nested SystemContainer gets the step as its
+    /// time.
+    auto add(std::shared_ptr<ISystem> system, double frequency, unsigned int maxStepsPerFrame = 1) -> SystemContainer*;
     template <typename T>
     inline auto add() -> SystemContainer*;
     template <typename T>
     inline SystemContainer* addCreate(std::shared_ptr<Context> context);
 
+    /// Names an added system in the profiler statistics and traces, the
+    /// flight recorder and the hardware counters, it is named after its
+    /// type (or the type of its reactive subsystem) by default. Does
+    /// nothing unless built with ENTITAS_PROFILE, ENTITAS_FLIGHT_RECORDER
+    /// or ENTITAS_HARDWARE_COUNTERS.
+    void setName(const std::shared_ptr<ISystem>& system, const std::string& name);
+
     void initialize() override;
+    /// Executes the systems, then the budgeted ones in priority order
+    /// until the budget of the container is exhausted. Budgeted systems
+    /// that did not get to run wait for the next frame.
+    /// Same as execute(deltaTime) with the time since the previous call.
     void execute() override;
+    /// Executes the systems in the order they were added, the ones added at
+    /// a rate as many steps as 'deltaTime' seconds make them due.
+    void execute(double deltaTime);
     void cleanup() override;
     void teardown() override;
-    //void fixedExecute();
 
     void activateReactiveSystems();
     /// Deactivates all ReactiveSystems in the systems list.
@@ -33,13 +64,72 @@ public:
     void deactivateReactiveSystems();
     void clearReactiveSystems();
 
+    /// Shared by all budgeted systems each frame, unlimited by default
+    void setBudget(const ExecutionLimits& limits);
+    auto getBudget() const -> const ExecutionLimits&;
+
+    /// Fixed steps not executed because a frame was too long
+    auto getDroppedStepsCount() const -> unsigned long;
+
 private:
+    /// When the system of the same index in executeSystems_ runs
+    struct Schedule {
+        /// Seconds per step, zero for every frame
+        double interval{ 0.0 };
+        /// Seconds accumulated towards the next step
+        double accumulated{ 0.0 };
+        unsigned int maxSteps{ 1 };
+        /// The system when it is a nested container
+        SystemContainer* container{ nullptr };
+    };
+
+    void executeStep(std::size_t index, double deltaTime);
+
+    void addBudgeted(std::shared_ptr<IBudgetedSystem> system);
+    /// The budgeted system, or null if the system runs every step
+    static auto getBudgeted(const std::shared_ptr<ISystem>& system) -> std::shared_ptr<IBudgetedSystem>;
+#ifdef ENTITAS_SYSTEM_NAMES
+    /// Profiler sections and the like of one system
+    struct Sections {
+#ifdef ENTITAS_PROFILE
+        Profiler::SectionId initialize;
+        Profiler::SectionId execute;
+        Profiler::SectionId cleanup;
+        Profiler::SectionId teardown;
+#endif
+#ifdef ENTITAS_FLIGHT_RECORDER
+        FlightRecorder::NameId recorderName;
+#endif
+#ifdef ENTITAS_HARDWARE_COUNTERS
+        HardwareCounters::SystemId hardware;
+#endif
+    };
+
+    /// By the address of the most derived object
+    auto getSections(const void* object) const -> const Sections&;
+    template <typename T>
+    inline auto getSections(const T* system) const -> const Sections&;
+#endif
+    template <typename F>
+    inline void forEachReactiveSystem(F fn);
+
     template <typename T>
     using SystemsVector = std::vector<std::shared_ptr<T>>;
     SystemsVector<IInitializeSystem> initializeSystems_;
     SystemsVector<IExecuteSystem> executeSystems_;
+    std::vector<Schedule> schedules_;
+    unsigned int scheduledCount_{ 0 };
+    unsigned long droppedSteps_{ 0 };
+    std::chrono::steady_clock::time_point lastExecute_{};
     SystemsVector<ICleanupSystem> cleanupSystems_;
     SystemsVector<ITearDownSystem> teardownSystems_;
+    /// Sorted by decreasing priority
+    SystemsVector<IBudgetedSystem> budgetedSystems_;
+    ExecutionLimits budget_;
+#ifdef ENTITAS_SYSTEM_NAMES
+    /// Reactive systems are there along with their subsystem
+    std::unordered_map<const void*, Sections> sections_;
+#endif
 };
 
 template <typename T>
@@ -48,6 +138,34 @@ auto SystemContainer::add() -> SystemContainer*
     return add(std::make_shared<T>());
 }
 
+#ifdef ENTITAS_SYSTEM_NAMES
+template <typename T>
+auto SystemContainer::getSections(const T* system) const -> const Sections&
+{
+    return getSections(dynamic_cast<const void*>(system));
+}
+#endif
+
+template <typename F>
+void SystemContainer::forEachReactiveSystem(F fn)
+{
+    for (const auto& system : executeSystems_) {
+        if (auto systemReactive = std::dynamic_pointer_cast<ReactiveSystem>(system)) {
+            fn(*systemReactive);
+        }
+
+        if (auto systemContainer = std::dynamic_pointer_cast<SystemContainer>(system)) {
+            systemContainer->forEachReactiveSystem(fn);
+        }
+    }
+
+    for (const auto& system : budgetedSystems_) {
+        if (auto systemReactive = std::dynamic_pointer_cast<ReactiveSystem>(system)) {
+            fn(*systemReactive);
+        }
+    }
+}
+
 template <typename T>
 SystemContainer* SystemContainer::addCreate(std::shared_ptr<Context> context)
 {
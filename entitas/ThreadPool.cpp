@@ -0,0 +1,146 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#include "ThreadPool.hpp"
+
+namespace entitas {
+
+namespace {
+    /// Set on pool threads and on callers while they run tasks
+    thread_local bool tRunningTasks = false;
+}
+
+auto ThreadPool::getDefaultWorkerCount() -> unsigned int
+{
+    auto threads = std::thread::hardware_concurrency();
+    return threads > 1 ? threads - 1 : 0;
+}
+
+auto ThreadPool::getShared() -> ThreadPool&
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+ThreadPool::ThreadPool(unsigned int workerCount)
+{
+    workers_.reserve(workerCount);
+    for (unsigned int i = 0; i < workerCount; ++i) {
+        workers_.emplace_back([this] { runWorker(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+
+    wakeWorkers_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+auto ThreadPool::getWorkerCount() const -> unsigned int
+{
+    return static_cast<unsigned int>(workers_.size());
+}
+
+void ThreadPool::parallelFor(std::size_t count, const std::function<void(std::size_t task)>& fn)
+{
+    if (count == 0) {
+        return;
+    }
+
+    if (count == 1 || workers_.empty() || tRunningTasks) {
+        for (std::size_t task = 0; task < count; ++task) {
+            fn(task);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> run(runMutex_);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fn_ = &fn;
+        count_ = count;
+        nextTask_.store(0, std::memory_order_relaxed);
+        exception_ = nullptr;
+        ++generation_;
+    }
+
+    wakeWorkers_.notify_all();
+
+    tRunningTasks = true;
+    runTasks();
+    tRunningTasks = false;
+
+    std::exception_ptr exception;
+    {
+        // Workers that joined late may still be running their last task
+        std::unique_lock<std::mutex> lock(mutex_);
+        wakeCaller_.wait(lock, [this] { return busyWorkers_ == 0; });
+        fn_ = nullptr;
+        exception = exception_;
+        exception_ = nullptr;
+    }
+
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+void ThreadPool::runWorker()
+{
+    tRunningTasks = true;
+    unsigned long seen = 0;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wakeWorkers_.wait(lock, [this, seen] { return stop_ || generation_ != seen; });
+            if (stop_) {
+                return;
+            }
+
+            seen = generation_;
+            // The caller might be done with all the tasks already
+            if (fn_ == nullptr) {
+                continue;
+            }
+            ++busyWorkers_;
+        }
+
+        runTasks();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --busyWorkers_;
+        }
+        wakeCaller_.notify_one();
+    }
+}
+
+void ThreadPool::runTasks()
+{
+    for (;;) {
+        auto task = nextTask_.fetch_add(1, std::memory_order_relaxed);
+        if (task >= count_) {
+            return;
+        }
+
+        try {
+            (*fn_)(task);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!exception_) {
+                exception_ = std::current_exception();
+            }
+        }
+    }
+}
+}
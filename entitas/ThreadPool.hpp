@@ -0,0 +1,65 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace entitas {
+
+/// Fixed set of worker threads running one parallelFor() at a time.
+/// The calling thread takes part in the work, so a pool with no workers
+/// simply runs everything on the caller.
+class ThreadPool {
+public:
+    /// One worker less than the hardware threads, the caller is the last one
+    static auto getDefaultWorkerCount() -> unsigned int;
+    /// The pool used by parallel reactive systems
+    static auto getShared() -> ThreadPool&;
+
+    explicit ThreadPool(unsigned int workerCount = getDefaultWorkerCount());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    auto getWorkerCount() const -> unsigned int;
+
+    /// Calls fn(task) for every task in [0, count) and returns once all of
+    /// them are done. Tasks are picked in increasing order by whichever
+    /// thread is free. The first exception thrown by a task is rethrown
+    /// here after the others finished.
+    /// Calls made from inside a task run on the calling thread.
+    void parallelFor(std::size_t count, const std::function<void(std::size_t task)>& fn);
+
+private:
+    void runWorker();
+    void runTasks();
+
+    std::vector<std::thread> workers_;
+    /// Serializes parallelFor() calls from different threads
+    std::mutex runMutex_;
+
+    std::mutex mutex_;
+    std::condition_variable wakeWorkers_;
+    std::condition_variable wakeCaller_;
+    bool stop_{ false };
+    /// Bumped for every parallelFor(), workers join each one once
+    unsigned long generation_{ 0 };
+    /// Workers still inside the current parallelFor()
+    unsigned int busyWorkers_{ 0 };
+
+    const std::function<void(std::size_t)>* fn_{ nullptr };
+    std::size_t count_{ 0 };
+    std::atomic<std::size_t> nextTask_{ 0 };
+    std::exception_ptr exception_;
+};
+}
@@ -0,0 +1,26 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#include "TypeName.hpp"
+
+#include <cstdlib>
+#include <memory>
+
+#if defined(__GNUC__)
+#include <cxxabi.h>
+#endif
+
+namespace entitas {
+auto getTypeName(const std::type_info& type) -> std::string
+{
+#if defined(__GNUC__)
+    int status = 0;
+    std::unique_ptr<char, void (*)(void*)> name{ abi::__cxa_demangle(type.name(), nullptr, nullptr, &status), std::free };
+    if (status == 0 && name) {
+        return name.get();
+    }
+#endif
+    return type.name();
+}
+} // namespace entitas
@@ -0,0 +1,13 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <string>
+#include <typeinfo>
+
+namespace entitas {
+/// Name of the type for diagnostics, demangled when the compiler allows it
+auto getTypeName(const std::type_info& type) -> std::string;
+} // namespace entitas
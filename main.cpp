@@ -4,7 +4,7 @@
 
 #include "entitas/SystemContainer.hpp"
 #include "entitas/Matcher.hpp"
-#include "entitas/Pool.hpp"
+#include "entitas/Context.hpp"
 #include <iostream>
 
 #include <string>
@@ -22,7 +22,7 @@ public:
 
 class DemoSystem : public IInitializeSystem, public IExecuteSystem, public ISetPoolSystem {
 public:
-  void setPool(Pool* pool)
+  void setPool(Context* pool) override
   {
     mPool = pool;
   }
@@ -41,7 +41,7 @@ public:
   }
 
 private:
-  Pool* mPool;
+  Context* mPool;
 };
 
 
@@ -84,7 +84,7 @@ public:
 class MySystem : public IInitializeSystem, public IExecuteSystem, public ISetPoolSystem
 {
 public:
-	void setPool(Pool* pool)
+	void setPool(Context* pool) override
 	{
 		pool_ = pool;
 		// #define COMPONENT_GET_TYPE_ID(COMPONENT_CLASS) EntitasPP::ComponentTypeId::Get<COMPONENT_CLASS>()
@@ -119,6 +119,8 @@ public:
 			auto mat = e->get<Position2>();
 			auto pos = e->get<Position>();
 			//renderMat(gSdlRenderer, mat->material.color, Vec2(pos->x, pos->y));
+			(void)mat;
+			(void)pos;
 		}
 		// std::cout << "There are " << entitiesCount << " entities with the component 'DemoComponent'" << std::endl;
 
@@ -126,7 +128,7 @@ public:
 	}
 
 private:
-	Pool* pool_{ nullptr };
+	Context* pool_{ nullptr };
 	std::shared_ptr<Group> group_;
 };
 
@@ -135,7 +137,7 @@ private:
 int main(const int argc, const char* argv[])
 {
   auto systems = std::make_shared<SystemContainer>();
-  auto pool = std::make_shared<Pool>();
+  auto pool = std::make_shared<Context>();
 
   systems->add(pool->createSystem<DemoSystem>());
   systems->add(pool->createSystem<MySystem>());
@@ -0,0 +1,394 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+#pragma once
+
+// Components and systems of sample2, without SDL so the headless scenario
+// can run them too
+
+#include "entitas/Context.hpp"
+#include "entitas/ISystem.hpp"
+#include "entitas/Matcher.hpp"
+#include "entitas/SpatialIndex.hpp"
+
+#include <mathfu/vector.h>
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using Vec2 = mathfu::Vector<float, 2>;
+
+constexpr int kScreenWidth = 600;
+constexpr int kScreenHeight = 800;
+
+using namespace entitas;
+
+/* -------------------------------------------------------------------------- */
+
+/// Seeded from std::random_device, reseed it for reproducible runs
+inline std::mt19937& getRandomEngine()
+{
+    static std::mt19937 engine{ std::random_device{}() };
+    return engine;
+}
+
+template <typename Iter, typename RandomGenerator>
+Iter select_randomly(Iter start, Iter end, RandomGenerator& g)
+{
+    std::uniform_int_distribution<> dis(0, std::distance(start, end) - 1);
+    std::advance(start, dis(g));
+    return start;
+}
+
+template <typename Iter>
+Iter select_randomly(Iter start, Iter end)
+{
+    return select_randomly(start, end, getRandomEngine());
+}
+
+// TODO move to entitas
+/// Returns nullptr when there are no entities
+inline entitas::EntityPtr randomEntity(Context& context)
+{
+    const auto& es = context.getEntities();
+    return es.empty() ? nullptr : *select_randomly(es.begin(), es.end());
+}
+
+inline entitas::EntityPtr randomEntity(Context& context, entitas::Matcher matcher)
+{
+    const auto& es = context.getEntities(matcher);
+    return es.empty() ? nullptr : *select_randomly(es.begin(), es.end());
+}
+
+/* -------------------------------------------------------------------------- */
+
+struct Color {
+    std::uint8_t r{ 0 };
+    std::uint8_t g{ 0 };
+    std::uint8_t b{ 0 };
+    std::uint8_t a{ 255 };
+};
+
+class PhysicsComponent : public IComponent {
+public:
+    void reset(Vec2 pos, Vec2 dims)
+    {
+        position_ = pos;
+        dimension_ = dims;
+    }
+    void reset(Vec2&& pos)
+    {
+        position_ = pos;
+    }
+    Vec2 position_;
+    Vec2 dimension_;
+};
+
+class AppearanceComponent : public IComponent {
+public:
+    void reset(Vec2 pos)
+    {
+        position_ = pos;
+    }
+
+    void reset(Vec2 pos, Vec2 size)
+    {
+        position_ = pos;
+        size_ = size;
+    }
+    Vec2 position_;
+    Vec2 size_;
+};
+
+/* -------------------------------------------------------------------------- */
+class InputComponent : public IComponent {
+public:
+    /// An SDL_Scancode in sample2
+    void reset(int code)
+    {
+        code_ = code;
+    }
+
+    int code_{ 0 };
+};
+
+class MoveComponent : public IComponent {
+public:
+    void reset(Vec2 d, float s)
+    {
+        direction = d;
+        speed = s;
+    }
+
+    Vec2 direction;
+    float speed{ 0.f };
+};
+
+class LifeComponent : public IComponent {
+public:
+    void reset(int val) { value_ = val; }
+    int value_{ 0 };
+};
+/* -------------------------------------------------------------------------- */
+
+class ClickComponent : public IComponent {
+public:
+    void reset(Vec2&& v) { position_ = v; }
+    Vec2 position_;
+};
+
+/* -------------------------------------------------------------------------- */
+
+struct RenderComponent : public IComponent {
+    void reset(Color c) { color = c; }
+    Color color;
+    Vec2 position;
+};
+
+/* -------------------------------------------------------------------------- */
+
+class MoveSystem : public IExecuteSystem, public ISetPoolSystem {
+    Group::SharedPtr _group;
+
+public:
+    void setPool(Context* context) override
+    {
+        auto matcher = Matcher::allOf(ComponentIdList{ COMPONENT_GET_TYPE_ID(MoveComponent), COMPONENT_GET_TYPE_ID(AppearanceComponent) });
+        _group = context->getGroup(matcher);
+    }
+
+    void execute() override
+    {
+        for (auto& e : _group->getEntities()) {
+            auto move = e->get<MoveComponent>();
+            auto appear = e->get<AppearanceComponent>();
+            Vec2 newPos = move->direction * move->speed + appear->position_;
+            e->replace<AppearanceComponent>(std::move(newPos));
+        }
+    }
+};
+
+/* -------------------------------------------------------------------------- */
+
+// Updates appearance from physics
+class PhysicsAppearanceSystem : public IReactiveSystem, public IEnsureComponents {
+public:
+    PhysicsAppearanceSystem()
+    {
+        trigger = (Matcher::allOf(ComponentIdList{ COMPONENT_GET_TYPE_ID(PhysicsComponent) })).onEntityAdded();
+        // Collected entities might have been destroyed since
+        ensureComponents = Matcher::allOf(ComponentIdList{ COMPONENT_GET_TYPE_ID(PhysicsComponent), COMPONENT_GET_TYPE_ID(AppearanceComponent) });
+    }
+
+    void execute(Entities& entities) override
+    {
+        // Gets executed only if the observed group changed.
+        // Changed entities are passed as an argument
+        for (auto& e : entities) {
+            auto physComp = e->get<PhysicsComponent>();
+            e->replace<AppearanceComponent>(physComp->position_, physComp->dimension_);
+        }
+    }
+};
+
+/* -------------------------------------------------------------------------- */
+
+// Updates render position
+class RenderAppearanceSystem : public IReactiveSystem, public IEnsureComponents {
+public:
+    RenderAppearanceSystem()
+    {
+        auto matcher = Matcher::allOf(ComponentIdList{ COMPONENT_GET_TYPE_ID(RenderComponent), COMPONENT_GET_TYPE_ID(AppearanceComponent) });
+        trigger = matcher.onEntityAdded();
+        // Collected entities might have been destroyed since
+        ensureComponents = matcher;
+    }
+
+    void execute(Entities& entities) override
+    {
+        // Gets executed only if the observed group changed.
+        // Changed entities are passed as an argument
+        for (auto& e : entities) {
+            auto appear = e->get<AppearanceComponent>();
+            auto ren = e->get<RenderComponent>();
+            // NOTE we don't call 'replace'
+            ren->position = appear->position_;
+        }
+    }
+};
+
+/* -------------------------------------------------------------------------- */
+
+// React on added clicks
+class ClickSystem : public IInitializeSystem, public IReactiveSystem, public ISetPoolSystem, public ICleanupSystem, public ITearDownSystem {
+protected:
+    Group::SharedPtr group_;
+    /// Entities with an appearance bucketed by their on-screen rectangle
+    std::shared_ptr<SpatialIndex<AppearanceComponent>> index_;
+    Entities hits_;
+
+public:
+    Context* context_{ nullptr };
+    ClickSystem()
+    {
+        trigger = (Matcher::allOf(ComponentIdList{ COMPONENT_GET_TYPE_ID(ClickComponent) })).onEntityAdded();
+    }
+    void initialize() override
+    {
+        group_ = context_->getGroup(Matcher::allOf(ComponentIdList{ COMPONENT_GET_TYPE_ID(AppearanceComponent) }));
+        index_ = std::make_shared<SpatialIndex<AppearanceComponent>>(group_,
+            [](const AppearanceComponent& a) {
+                auto botRight = a.position_ + a.size_;
+                return Aabb{ a.position_.x(), a.position_.y(), botRight.x(), botRight.y() };
+            },
+            100.f);
+    }
+
+    void setPool(Context* context) override
+    {
+        context_ = context;
+    }
+    void execute(Entities& entities) override
+    {
+        for (auto& e : entities) {
+            // we should only get one at a time
+            auto pos = e->get<ClickComponent>()->position_;
+            // only the entities whose rectangle contains the click
+            hits_.clear();
+            index_->queryPoint(pos.x(), pos.y(), hits_);
+            for (auto& ep : hits_) {
+                context_->destroyEntity(ep);
+            }
+            hits_.clear();
+
+            context_->destroyEntity(e);
+        }
+    }
+
+    void cleanup() override
+    {
+    }
+
+    void teardown() override
+    {
+        index_.reset();
+        group_.reset();
+    }
+};
+/* -------------------------------------------------------------------------- */
+
+// React on key presses, gets a random entity moving
+class InputSystem : public IReactiveSystem, public ISetPoolSystem {
+public:
+    Context* context_{ nullptr };
+    InputSystem()
+    {
+        trigger = (Matcher::allOf(ComponentIdList{ COMPONENT_GET_TYPE_ID(InputComponent) })).onEntityAdded();
+    }
+
+    void setPool(Context* context) override
+    {
+        context_ = context;
+    }
+    void execute(Entities& entities) override
+    {
+        static auto matcher = Matcher::allOf(ComponentIdList{ COMPONENT_GET_TYPE_ID(MoveComponent) });
+        for (auto& e : entities) {
+            if (auto moving = randomEntity(*context_, matcher)) {
+                moving->replace<MoveComponent>(Vec2{ 3.f, 1.f }, 1.f);
+            }
+
+            context_->destroyEntity(e);
+        }
+    }
+};
+/* -------------------------------------------------------------------------- */
+
+/// A rectangle to draw
+struct RenderQuad {
+    Color color;
+    Vec2 position;
+    Vec2 size;
+};
+
+/// Extracts what has to be drawn this frame, the renderer only gets quads
+class RenderExtractSystem : public IExecuteSystem, public ISetPoolSystem {
+public:
+    void setPool(Context* context) override
+    {
+        group_ = context->getGroup(Matcher::allOf(ComponentIdList{ COMPONENT_GET_TYPE_ID(RenderComponent), COMPONENT_GET_TYPE_ID(AppearanceComponent) }));
+    }
+
+    void execute() override
+    {
+        quads_.clear();
+        for (auto& e : group_->getEntities()) {
+            auto ren = e->get<RenderComponent>();
+            auto appearance = e->get<AppearanceComponent>();
+            quads_.push_back(RenderQuad{ ren->color, ren->position, appearance->size_ });
+        }
+    }
+
+    auto getQuads() const -> const std::vector<RenderQuad>& { return quads_; }
+
+protected:
+    Group::SharedPtr group_;
+    std::vector<RenderQuad> quads_;
+};
+
+/* -------------------------------------------------------------------------- */
+
+inline Color randomColor()
+{
+    std::uniform_int_distribution<int> uniform_int(50, 254);
+    auto& engine = getRandomEngine();
+    Color c;
+    c.r = static_cast<std::uint8_t>(uniform_int(engine));
+    c.g = static_cast<std::uint8_t>(uniform_int(engine));
+    c.b = static_cast<std::uint8_t>(uniform_int(engine));
+    return c;
+}
+
+inline Vec2 randomVec2(int x, int y, int mx, int my)
+{
+    std::uniform_real_distribution<float> unifW(x, mx);
+    std::uniform_real_distribution<float> unifH(y, my);
+    auto& engine = getRandomEngine();
+    // Sequenced, the order of function arguments is not
+    auto w = unifW(engine);
+    auto h = unifH(engine);
+    return Vec2{ w, h };
+}
+
+inline Vec2 randomVec2Pos()
+{
+    return randomVec2(0, 0, kScreenWidth, kScreenHeight);
+}
+
+inline Vec2 randomVec2Size()
+{
+    return randomVec2(20, 20, 80, 100);
+}
+
+/* -------------------------------------------------------------------------- */
+// Random Entity with Color, AppearanceComponent and Size
+inline void addRandomEntity(Context* context)
+{
+    auto e = context->createEntity();
+    e->add<RenderComponent>(randomColor());
+    e->add<PhysicsComponent>(randomVec2Pos(), randomVec2Size());
+    e->add<AppearanceComponent>(randomVec2Pos(), randomVec2Size());
+    e->add<MoveComponent>(Vec2(0.f), 0.f);
+    e->add<LifeComponent>(1);
+}
+
+inline void changeRandomEntity(Context* context)
+{
+    auto entity = randomEntity(*context);
+    if (entity && entity->has<PhysicsComponent>()) {
+        auto comp = entity->get<PhysicsComponent>()->dimension_;
+        entity->replace<PhysicsComponent>(randomVec2Pos(), comp);
+    }
+}
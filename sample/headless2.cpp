@@ -0,0 +1,226 @@
+// Copyright (c) 2017 Igor M
+// License: MIT License
+// MIT License web page: https://opensource.org/licenses/MIT
+
+// The systems of sample2 without a window: a scripted random input driver
+// feeds them for a fixed number of ticks, then the per-system and per-frame
+// timing percentiles are reported.
+//
+// headless2 [--entities N] [--ticks N] [--spawn N] [--changes N]
+//           [--clicks N] [--inputs N] [--seed N] [--json path]
+// The spawn, changes, clicks and inputs counts are per tick.
+
+#include "Sample2Systems.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* -------------------------------------------------------------------------- */
+
+struct Options {
+    unsigned int entities{ 10000 };
+    unsigned int ticks{ 1000 };
+    unsigned int spawn{ 10 };
+    unsigned int changes{ 100 };
+    unsigned int clicks{ 1 };
+    unsigned int inputs{ 1 };
+    unsigned int seed{ 1 };
+    const char* jsonPath{ nullptr };
+};
+
+static bool parseOptions(int argc, const char* argv[], Options& options)
+{
+    struct Flag {
+        const char* name;
+        unsigned int* value;
+    };
+    const Flag flags[] = {
+        { "--entities", &options.entities },
+        { "--ticks", &options.ticks },
+        { "--spawn", &options.spawn },
+        { "--changes", &options.changes },
+        { "--clicks", &options.clicks },
+        { "--inputs", &options.inputs },
+        { "--seed", &options.seed },
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        if (i + 1 >= argc) {
+            return false;
+        }
+
+        if (std::strcmp(argv[i], "--json") == 0) {
+            options.jsonPath = argv[++i];
+            continue;
+        }
+
+        auto flag = std::find_if(std::begin(flags), std::end(flags), [&](const Flag& f) { return std::strcmp(argv[i], f.name) == 0; });
+        if (flag == std::end(flags)) {
+            return false;
+        }
+        *flag->value = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+    }
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+/// Execute times of one system, or of whole frames, in microseconds
+struct Timings {
+    std::string name;
+    std::vector<double> samples;
+
+    auto percentile(double p) const -> double
+    {
+        if (samples.empty()) {
+            return 0.0;
+        }
+
+        auto sorted = samples;
+        auto index = static_cast<std::size_t>(p * (sorted.size() - 1) + 0.5);
+        std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+        return sorted[index];
+    }
+
+    auto max() const -> double
+    {
+        return samples.empty() ? 0.0 : *std::max_element(samples.begin(), samples.end());
+    }
+};
+
+using Clock = std::chrono::steady_clock;
+
+static auto getElapsedUs(Clock::time_point start) -> double
+{
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+/* -------------------------------------------------------------------------- */
+
+/// Plays the user: spawns, moves, clicks and presses keys at random
+static void driveInput(Context& context, const Options& options)
+{
+    for (unsigned int i = 0; i < options.spawn; ++i) {
+        addRandomEntity(&context);
+    }
+
+    for (unsigned int i = 0; i < options.changes; ++i) {
+        changeRandomEntity(&context);
+    }
+
+    for (unsigned int i = 0; i < options.clicks; ++i) {
+        context.createEntity()->add<ClickComponent>(randomVec2Pos());
+    }
+
+    std::uniform_int_distribution<int> keys(4, 29);
+    for (unsigned int i = 0; i < options.inputs; ++i) {
+        context.createEntity()->add<InputComponent>(keys(getRandomEngine()));
+    }
+}
+
+static void printReport(const std::vector<Timings>& timings, const Options& options, unsigned int entitiesLeft)
+{
+    std::printf("%u ticks, %u entities at start, %u at the end, seed %u\n", options.ticks, options.entities, entitiesLeft, options.seed);
+    std::printf("%-24s %10s %10s %10s %10s   (us)\n", "", "p50", "p90", "p99", "max");
+    for (const auto& t : timings) {
+        std::printf("%-24s %10.1f %10.1f %10.1f %10.1f\n", t.name.c_str(), t.percentile(0.5), t.percentile(0.9), t.percentile(0.99), t.max());
+    }
+}
+
+static bool writeJson(const char* path, const std::vector<Timings>& timings, const Options& options)
+{
+    auto file = std::fopen(path, "w");
+    if (file == nullptr) {
+        return false;
+    }
+
+    std::fprintf(file, "{\n  \"ticks\": %u,\n  \"entities\": %u,\n  \"seed\": %u,\n  \"timings_us\": [\n", options.ticks, options.entities, options.seed);
+    for (std::size_t i = 0; i < timings.size(); ++i) {
+        const auto& t = timings[i];
+        std::fprintf(file, "    { \"name\": \"%s\", \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f }%s\n",
+            t.name.c_str(), t.percentile(0.5), t.percentile(0.9), t.percentile(0.99), t.max(), i + 1 < timings.size() ? "," : "");
+    }
+    std::fprintf(file, "  ]\n}\n");
+
+    return std::fclose(file) == 0;
+}
+
+/* -------------------------------------------------------------------------- */
+
+int main(const int argc, const char* argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::fprintf(stderr, "usage: %s [--entities N] [--ticks N] [--spawn N] [--changes N] [--clicks N] [--inputs N] [--seed N] [--json path]\n", argv[0]);
+        return 1;
+    }
+
+    getRandomEngine().seed(options.seed);
+    auto context = std::make_shared<Context>();
+
+    // Same order as sample2, the render extraction takes the place of the
+    // rendering system
+    auto clickSystem = std::make_shared<ClickSystem>();
+    struct Stage {
+        const char* name;
+        std::shared_ptr<ISystem> system;
+    };
+    const std::vector<Stage> stages = {
+        { "RenderAppearanceSystem", context->createSystem<RenderAppearanceSystem>() },
+        { "PhysicsAppearanceSystem", context->createSystem<PhysicsAppearanceSystem>() },
+        { "RenderExtractSystem", context->createSystem<RenderExtractSystem>() },
+        { "ClickSystem", context->createSystem(clickSystem) },
+        { "InputSystem", context->createSystem<InputSystem>() },
+        { "MoveSystem", context->createSystem<MoveSystem>() },
+    };
+
+    clickSystem->initialize();
+    for (unsigned int i = 0; i < options.entities; ++i) {
+        addRandomEntity(context.get());
+    }
+
+    std::vector<Timings> timings;
+    for (const auto& stage : stages) {
+        timings.push_back(Timings{ stage.name, {} });
+    }
+    timings.push_back(Timings{ "input", {} });
+    timings.push_back(Timings{ "frame", {} });
+    for (auto& t : timings) {
+        t.samples.reserve(options.ticks);
+    }
+
+    auto& inputTimings = timings[timings.size() - 2];
+    auto& frameTimings = timings.back();
+    for (unsigned int tick = 0; tick < options.ticks; ++tick) {
+        auto frameStart = Clock::now();
+
+        driveInput(*context, options);
+        inputTimings.samples.push_back(getElapsedUs(frameStart));
+
+        for (std::size_t i = 0; i < stages.size(); ++i) {
+            auto start = Clock::now();
+            std::static_pointer_cast<IExecuteSystem>(stages[i].system)->execute();
+            timings[i].samples.push_back(getElapsedUs(start));
+        }
+
+        context->flush();
+        frameTimings.samples.push_back(getElapsedUs(frameStart));
+    }
+
+    clickSystem->teardown();
+    printReport(timings, options, context->count());
+
+    if (options.jsonPath != nullptr && !writeJson(options.jsonPath, timings, options)) {
+        std::fprintf(stderr, "cannot write %s\n", options.jsonPath);
+        return 1;
+    }
+
+    return 0;
+}
@@ -1,9 +1,8 @@
 #include "entitas/Collector.hpp"
-#include "entitas/ISystem.hpp"
-#include "entitas/Matcher.hpp"
-#include "entitas/Context.hpp"
 #include "entitas/SystemContainer.hpp"
 
+#include "Sample2Systems.hpp"
+
 //#include <iostream>
 #include <random>
 
@@ -35,368 +34,29 @@
 
 #include "Rectangle.h"
 
-constexpr int kScreenWidth = 600;
-constexpr int kScreenHeight = 800;
-
-using namespace entitas;
-
-/* -------------------------------------------------------------------------- */
-
-
-template <typename Iter, typename RandomGenerator>
-Iter select_randomly(Iter start, Iter end, RandomGenerator& g)
-{
-    std::uniform_int_distribution<> dis(0, std::distance(start, end) - 1);
-    std::advance(start, dis(g));
-    return start;
-}
-
-template <typename Iter>
-Iter select_randomly(Iter start, Iter end)
-{
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    return select_randomly(start, end, gen);
-}
-// TODO move to entitas
-entitas::EntityPtr randomEntity(Context& context)
-{
-    auto es = context.getEntities();
-    auto randomEntity = *select_randomly(es.begin(), es.end());
-    return randomEntity;
-}
-entitas::EntityPtr randomEntity(Context& context, entitas::Matcher matcher)
-{
-    auto es = context.getEntities(matcher);
-    auto randomEntity = *select_randomly(es.begin(), es.end());
-    return randomEntity;
-}
-
-
-/* -------------------------------------------------------------------------- */
-
-class PhysicsComponent : public IComponent {
-public:
-    void reset(Vec2 pos, Vec2 dims)
-    {
-        position_ = pos;
-        dimension_ = dims;
-    }
-    void reset(Vec2&& pos)
-    {
-        position_ = pos;
-    }
-    Vec2 position_;
-    Vec2 dimension_;
-};
-
-class AppearanceComponent : public IComponent {
-public:
-    void reset(Vec2 pos)
-    {
-        position_ = pos;
-    }
-
-    void reset(Vec2 pos, Vec2 size)
-    {
-        position_ = pos;
-        size_ = size;
-    }
-    Vec2 position_;
-    Vec2 size_;
-};
-
-/* -------------------------------------------------------------------------- */
-class InputComponent : public IComponent {
-public:
-    void reset(SDL_Scancode code)
-    {
-        code_ = code;
-    }
-    
-    SDL_Scancode code_;
-};
-
-class MoveComponent : public IComponent {
-public:
-    void reset(Vec2 d, float s)
-    {
-        direction = d;
-        speed = s;
-    }
-
-    Vec2 direction;
-    float speed{ 0.f };
-};
-
-class LifeComponent : public IComponent {
-public:
-    void reset(int val) { value_ = val; }
-    int value_{ 0 };
-};
-/* -------------------------------------------------------------------------- */
-
-class ClickComponent : public IComponent {
-public:
-    void reset(Vec2&& v) { position_ = v; }
-    Vec2 position_;
-};
-
-/* -------------------------------------------------------------------------- */
-
-struct RenderComponent : public IComponent {
-    void reset(Material m) { material = m; }
-    Material material;
-    Vec2 position;
-};
-
-/* -------------------------------------------------------------------------- */
-
-class MoveSystem : public IExecuteSystem, public ISetPoolSystem {
-    Group::SharedPtr _group;
-
-public:
-    void setPool(Context* context)
-    {
-        auto matcher = Matcher::allOf({ COMPONENT_GET_TYPE_ID(MoveComponent), COMPONENT_GET_TYPE_ID(AppearanceComponent) });
-    }
-
-    void execute()
-    {
-        for (auto& e : _group->getEntities()) {
-            auto move = e->get<MoveComponent>();
-            auto appear = e->get<AppearanceComponent>();
-            Vec2 newPos = move->direction * move->speed + appear->position_;
-            e->replace<AppearanceComponent>(std::move(newPos));
-        }
-    }
-};
-
-/* -------------------------------------------------------------------------- */
-
-// Updates appearance from physics
-class PhysicsAppearanceSystem : public IReactiveSystem {
-public:
-    PhysicsAppearanceSystem()
-    {
-        trigger = (Matcher::allOf({ COMPONENT_GET_TYPE_ID(PhysicsComponent) })).onEntityAdded();
-    }
-
-    void execute(Entities& entities) override
-    {
-        // Gets executed only if the observed group changed.
-        // Changed entities are passed as an argument
-        for (auto& e : entities) {
-            if (e->has<AppearanceComponent>()) {
-                //auto apComp= e->get<AppearanceComponent>();
-                auto physComp = e->get<PhysicsComponent>();
-                //ren->position = pos->position_;
-                e->replace<AppearanceComponent>(physComp->position_, physComp->dimension_);
-            }
-        }
-    }
-};
-
-/* -------------------------------------------------------------------------- */
-
-// Updates render position
-class RenderAppearanceSystem : public IReactiveSystem {
-public:
-    RenderAppearanceSystem()
-    {
-        trigger = (Matcher::allOf({ COMPONENT_GET_TYPE_ID(RenderComponent), COMPONENT_GET_TYPE_ID(AppearanceComponent) })).onEntityAdded();
-    }
-
-    void execute(Entities& entities) override
-    {
-        // Gets executed only if the observed group changed.
-        // Changed entities are passed as an argument
-        for (auto& e : entities) {
-            auto appear = e->get<AppearanceComponent>();
-            auto ren = e->get<RenderComponent>();
-            // NOTE we don't call 'replace'
-            ren->position = appear->position_;
-        }
-    }
-};
-
-/* -------------------------------------------------------------------------- */
-
-// React on added clicks
-class ClickSystem : public IInitializeSystem, public IReactiveSystem, public ISetPoolSystem, public ICleanupSystem, public ITearDownSystem {
-protected:
-    Group::SharedPtr group_;
-
-public:
-    Context* context_{ nullptr };
-    ClickSystem()
-    {
-        trigger = (Matcher::allOf({ COMPONENT_GET_TYPE_ID(ClickComponent) })).onEntityAdded();
-    }
-    void initialize() override
-    {
-        group_ = context_->getGroup(Matcher::allOf({ COMPONENT_GET_TYPE_ID(AppearanceComponent) }));
-    }
-
-    void setPool(Context* context) override
-    {
-        context_ = context;
-    }
-    void execute(Entities& entities) override
-    {
-        for (auto& e : entities) {
-            // we should only get one at a time
-            auto pos = e->get<ClickComponent>()->position_;
-            // now iterate through all entities with a position component
-            for (auto& ep : group_->getEntities()) {
-                auto posE = ep->get<AppearanceComponent>()->position_;
-                auto sizeE = ep->get<AppearanceComponent>()->size_;
-                auto botRight = posE + sizeE;
-                if ((pos.x() >= posE.x()) && (pos.x() <= botRight.x()) && (pos.y() >= posE.y()) && (pos.y() <= botRight.y()))
-                    context_->destroyEntity(ep);
-            }
-
-            context_->destroyEntity(e);
-            // auto ren = e->get<RenderComponent>();
-            // ren->position = pos->position_;
-        }
-    }
-
-    void cleanup() override
-    {
-    }
-
-    void teardown() override
-    {
-        group_.reset();
-    }
-};
-/* -------------------------------------------------------------------------- */
-
-// React on added clicks
-class InputSystem : public IInitializeSystem, public IReactiveSystem, public ISetPoolSystem, public ICleanupSystem, public ITearDownSystem {
-protected:
-    //Group::SharedPtr group_;
-    
-public:
-    Context* context_{ nullptr };
-    InputSystem()
-    {
-        trigger = (Matcher::allOf({ COMPONENT_GET_TYPE_ID(InputComponent) })).onEntityAdded();
-    }
-    void initialize() override
-    {
-        //group_ = context_->getGroup(Matcher::allOf({ COMPONENT_GET_TYPE_ID(Component) }));
-    }
-    
-    void setPool(Context* context) override
-    {
-        context_ = context;
-    }
-    void execute(Entities& entities) override
-    {
-        for (auto& e : entities) {
-            // we should only get one at a time
-            static auto matcher = Matcher::allOf({ COMPONENT_GET_TYPE_ID(MoveComponent) });
-            auto pos = e->get<InputComponent>()->code_;
-            
-            auto e2 = randomEntity(*context_, matcher);
-            auto moveComp = e2->get<MoveComponent>();
-            e2->replace<MoveComponent>(Vec2{3.f, 1.f}, 1.f);
-            
-            context_->destroyEntity(e);
-            // auto ren = e->get<RenderComponent>();
-            // ren->position = pos->position_;
-        }
-    }
-    
-    void cleanup() override
-    {
-    }
-    
-    void teardown() override
-    {
-        //group_.reset();
-    }
-};
-/* -------------------------------------------------------------------------- */
-
 void renderMat(sdl::Renderer* renderer, sdl::Color c, const Vec2& v, const Vec2& s)
 {
     auto rect = sdl::makeRect(v, s);
     renderer->draw(rect, c);
 }
 
-sdl::Color randomColor()
+sdl::Color toSdlColor(Color c)
 {
-    using namespace std;
-    static random_device rd;
-    static mt19937 engineMt(rd());
-    uniform_int_distribution<int> uniform_int(50, 254);
-    //auto random_int = bind(uniform_int, engineMt);
-    // static const unsigned sizeVec{ 10 };
-    sdl::Color c(uniform_int(engineMt), uniform_int(engineMt), uniform_int(engineMt));
-    return c;
+    return sdl::Color(c.r, c.g, c.b);
 }
 
 /* -------------------------------------------------------------------------- */
 
-Vec2 randomVec2(int x, int y, int mx, int my)
-{
-    using namespace std;
-    static random_device rd;
-    static mt19937 engineMt(rd());
-    uniform_real_distribution<float> unifW(x, mx);
-    uniform_real_distribution<float> unifH(y, my);
-    Vec2 v{ unifW(engineMt), unifH(engineMt) };
-    return v;
-}
-
-/* -------------------------------------------------------------------------- */
-
-Vec2 randomVec2Pos()
-{
-    return randomVec2(0, 0, kScreenWidth, kScreenHeight);
-}
-
-/* -------------------------------------------------------------------------- */
-
-Vec2 randomVec2Size()
-{
-    return randomVec2(20, 20, 80, 100);
-}
-
-/* -------------------------------------------------------------------------- */
-// Random Entity with Color, AppearanceComponent and Size
-void addRandomEntity(Context* context)
-{
-    auto e = context->createEntity();
-    e->add<RenderComponent>(randomColor());
-    e->add<PhysicsComponent>(randomVec2Pos(), randomVec2Size());
-    e->add<AppearanceComponent>(randomVec2Pos(), randomVec2Size());
-    e->add<MoveComponent>(Vec2(0.f), 0.f);
-    //e->add<Appearance>(randomVec2Size());
-    e->add<LifeComponent>(1);
-    auto r = context->hasEntity(e);
-    //std::cout << r;
-}
-
-void changeRandomEntity(Context* context)
-{
-    auto entity = randomEntity(*context);
-    auto comp = entity->get<PhysicsComponent>()->dimension_;
-    entity->replace<PhysicsComponent>(randomVec2Pos(), comp);
-}
-
 // This is actually render system as it renders our quads
-class MySystem : public IInitializeSystem, public IExecuteSystem, public ISetPoolSystem, public ICleanupSystem, public ITearDownSystem {
+class MySystem : public RenderExtractSystem, public IInitializeSystem, public ICleanupSystem, public ITearDownSystem {
 public:
-    void setPool(Context* context)
+    void setPool(Context* context) override
     {
+        RenderExtractSystem::setPool(context);
         context_ = context;
         auto matcher = Matcher::allOf({ COMPONENT_GET_TYPE_ID(RenderComponent) });
-        group_ = context_->getGroup(matcher);
-        collector_ = group_->createCollector(GroupEventType::Added);
+        renderGroup_ = context_->getGroup(matcher);
+        collector_ = renderGroup_->createCollector(GroupEventType::Added);
         //collector_->activate();
         fmt::print("MySystem::setPool called\n");
     }
@@ -409,11 +69,9 @@ public:
 
     void execute() override
     {
-        auto es = group_->getEntities();
-        for (auto& e : es) {
-            auto ren = e->get<RenderComponent>();
-            auto appearance = e->get<AppearanceComponent>();
-            renderMat(renderer_, ren->material.color, ren->position, appearance->size_);
+        RenderExtractSystem::execute();
+        for (const auto& quad : getQuads()) {
+            renderMat(renderer_, toSdlColor(quad.color), quad.position, quad.size);
         }
 
         for (auto& e : (collector_->getCollectedEntities())) {
@@ -430,6 +88,7 @@ public:
     {
         collector_->deactivate();
         collector_.reset();
+        renderGroup_.reset();
         group_.reset();
     }
 
@@ -437,6 +96,11 @@ public:
 
 private:
     sdl::Renderer* renderer_{ nullptr };
+    Context* context_{ nullptr };
+    Group::SharedPtr renderGroup_;
+    // test
+    std::shared_ptr<Collector> collector_;
+};
     Context* context_{ nullptr };
     Group::SharedPtr group_;
     // test
@@ -484,7 +148,7 @@ void mainLoop(void* vctx)
                 //fmt::print("pressed right");
                 auto context = ctx->context.get();
                 auto e = context->createEntity();
-                e->add<InputComponent>(scancode);
+                e->add<InputComponent>(static_cast<int>(scancode));
             }
         }
         if (event.type == SDL_MOUSEBUTTONDOWN) {